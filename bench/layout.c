@@ -0,0 +1,73 @@
+// Memory layout benchmark for SAT objects, without a window.
+// Build it once per layout and compare them under `perf stat`, see `make bench-layout`.
+// Usage: layout [objects] [frames]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <SAT.h>
+
+// Regular polygons scattered over the world, sized like configureSAT's at the same object count.
+static void scatterPolygons(SAT_Object objects[], size_t count) {
+  double radius = fmax(0.02, 1.0 / pow(1.005, count));
+
+  for (size_t i = 0; i < count; i++) {
+    SAT_Object *object = &objects[i];
+
+    if (!SAT_initObject(object)) {
+      fprintf(stderr, "Failed to allocate object %zu.\n", i);
+      exit(1);
+    }
+
+    int verticesCount = 3 + rand() % (SAT_MAX_VERTICES - 2);
+    double angIncrement = 2 * PI / (double)verticesCount;
+
+    for (int v = 0; v < verticesCount; v++) {
+      object->vertices[v] = (Vector2){radius * cos(angIncrement * v), radius * sin(angIncrement * v)};
+    }
+
+    object->vertices_count = verticesCount;
+    SAT_updateShape(object);
+    object->position = (Vector2){radius + (WIDTH - 2 * radius) * rand() / RAND_MAX,
+                                 radius + (HEIGHT - 2 * radius) * rand() / RAND_MAX};
+    object->velocity = (Vector2){2.0 * rand() / RAND_MAX - 1, 2.0 * rand() / RAND_MAX - 1};
+    object->col = (Color){255, 255, 255, 255};
+    object->mass = 1 + 4.0 * rand() / RAND_MAX;
+  }
+}
+
+int main(int argc, char **argv) {
+  size_t count = argc > 1 ? strtoul(argv[1], NULL, 10) : 5000;
+  int frames = argc > 2 ? atoi(argv[2]) : 300;
+
+  srand(1);
+
+  SAT_Object *objects = (SAT_Object *)calloc(count, sizeof(SAT_Object));
+  Broadphase broadphase = Broadphase_create(SweepAndPrune);
+
+  scatterPolygons(objects, count);
+
+  struct timespec start;
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  for (int frame = 0; frame < frames; frame++) {
+    SAT_simulate(objects, count, 1 / 90.0F, &broadphase, NULL);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  double elapsed = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+  printf("%s layout: %zu objects (%zu bytes each), %.3f ms per tick\n", SAT_INLINE_VERTICES ? "inline" : "pointer",
+         count, sizeof(SAT_Object), elapsed / frames);
+
+  for (size_t i = 0; i < count; i++) {
+    SAT_freeObject(&objects[i]);
+  }
+
+  Broadphase_free(&broadphase);
+  free(objects);
+  return 0;
+}
@@ -0,0 +1,102 @@
+// Differential check and benchmark of the SAT separating-axis kernels, without a window.
+// Every kernel this CPU supports must give the same verdict as the scalar SAT_colliding on random convex polygons,
+// the program exits with 1 if any of them disagree. See `make bench-sat-kernels`.
+// Usage: sat_kernels [pairs]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <SAT.h>
+
+static double randomRange(double min, double max) { return min + (max - min) * rand() / RAND_MAX; }
+
+// A convex polygon with random vertex count, radius and (sorted) vertex angles around a random position.
+static void randomPolygon(SAT_Object *object) {
+  if (!SAT_initObject(object)) {
+    fprintf(stderr, "Failed to allocate a polygon.\n");
+    exit(1);
+  }
+
+  int verticesCount = 3 + rand() % (SAT_MAX_VERTICES - 2);
+  double radius = randomRange(0.05, 0.5);
+  double angles[SAT_MAX_VERTICES];
+
+  for (int v = 0; v < verticesCount; v++) {
+    angles[v] = randomRange(0, 2 * PI);
+  }
+
+  for (int v = 1; v < verticesCount; v++) {
+    for (int w = v; w > 0 && angles[w - 1] > angles[w]; w--) {
+      double swap = angles[w];
+      angles[w] = angles[w - 1];
+      angles[w - 1] = swap;
+    }
+  }
+
+  for (int v = 0; v < verticesCount; v++) {
+    object->vertices[v] = (Vector2){radius * cos(angles[v]), radius * sin(angles[v])};
+  }
+
+  object->vertices_count = verticesCount;
+  SAT_updateShape(object);
+  object->position = (Vector2){randomRange(0, 2), randomRange(0, 2)};
+}
+
+int main(int argc, char **argv) {
+  size_t pairs = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+  SAT_Object *objects = (SAT_Object *)calloc(2 * pairs, sizeof(SAT_Object));
+  bool *expected = (bool *)calloc(pairs, sizeof(bool));
+
+  srand(1);
+
+  for (size_t i = 0; i < 2 * pairs; i++) {
+    randomPolygon(&objects[i]);
+  }
+
+  size_t hits = 0;
+
+  for (size_t p = 0; p < pairs; p++) {
+    expected[p] = SAT_colliding(objects[2 * p], objects[2 * p + 1]);
+    hits += expected[p];
+  }
+
+  printf("%zu pairs, %zu colliding\n", pairs, hits);
+
+  SAT_Kernel kernels[] = {{SAT_separatedScalar, "scalar"},
+#if defined(__x86_64__) || defined(__i386__)
+                          {SAT_separatedSSE2, "sse2"},
+                          {SAT_separatedAVX2, "avx2"},
+#endif
+  };
+  int failed = 0;
+
+  for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+#if defined(__x86_64__) || defined(__i386__)
+    if (kernels[k].separated == SAT_separatedAVX2 && !__builtin_cpu_supports("avx2")) {
+      printf("%-6s unsupported on this CPU\n", kernels[k].name);
+      continue;
+    }
+#endif
+
+    size_t mismatches = 0;
+    struct timespec start;
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (size_t p = 0; p < pairs; p++) {
+      mismatches += kernels[k].separated(&objects[2 * p], &objects[2 * p + 1]) == expected[p];
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double elapsed = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+    printf("%-6s %.2f ns per pair, %zu mismatches\n", kernels[k].name, elapsed / pairs, mismatches);
+    failed |= mismatches != 0;
+  }
+
+  free(objects);
+  free(expected);
+  return failed;
+}
@@ -1,8 +1,13 @@
 // Axis-Aligned Bounding Box.
 
+#include <broadphase.h>
 #include <common.h>
 #include <math.h>
+#include <narrowphase.h>
+#include <overlap.h>
+#include <phases.h>
 #include <raymath.h>
+#include <stdint.h>
 
 typedef struct {
   double x;
@@ -124,127 +129,504 @@ static Vector2 getDV_DU(AABB_Object A, AABB_Object B, bool yDirection) {
   return Vector2Scale((Vector2){(-2.0F * B.mass * vMinU), (2.0F * A.mass * vMinU)}, 1 / massSum);
 }
 
-void AABB_simulate(AABB_Object obj[], size_t objSize, float dt) {
-  // Apply gravitational acceleration first before checking for collisions.
-  for (size_t i = 0; i < objSize; i++) {
-    obj[i].dy += GRAVITY * dt;
+// TODO: make this work correctly with circle and circle-rectangle collisions.
+// When colliding, they will bounce according to the law of conservation of momentum.
+// Due to limitations in AABB collision detection and what-not, every object will
+// bounce in the x- or y-axis, never at an angle. Therefore, the collision will be done
+// according to their shapes, but with the calculations according to a rectangle.
+// Respond to two objects known to be colliding.
+// Returns false on a false positive, which ends the collision checks of a for this frame.
+static bool AABB_respond(AABB_Object *a, AABB_Object *b) {
+  // Get the axis of bounce in regards to (*a).
+  Side axis = rectangle_side((*a), (*b));
+
+  // ensure that they don't give a false positive
+  bool falsePositive = (axis == Top && (*b).dy < (*a).dy) || (axis == Bottom && (*b).dy > (*a).dy) ||
+                       (axis == Left && (*b).dx < (*a).dx) || (axis == Right && (*b).dx > (*a).dx);
+
+  if (falsePositive)
+    return false;
+
+  if (!(*a).isCircle && !(*b).isCircle) {
+    // When hit on the y-axis, dy is changed and dx is constant.
+    if (axis == Top || axis == Bottom) {
+      Vector2 dy = getDV_DU((*a), (*b), true);
+
+      // printf("VERTICAL: (%d)\n%.3f %.3f\n", (*a).col.g, dy.x, dy.y);
+
+      (*a).dy += dy.x;
+      (*b).dy += dy.y;
+
+      // Move out of each other.
+      if (axis == Top) {
+        (*a).y += fabs(top((*a)) - bottom((*b)));
+      } else {
+        (*a).y -= fabs(bottom((*a)) - top((*b)));
+      }
+    } else {
+      // If not on the y-axis, then on the x-axis.
+      Vector2 dx = getDV_DU((*a), (*b), false);
+
+      // printf("HORIZ: (%d)\n%.3f %.3f\n", (*a).col.g, dx.x, dx.y);
+
+      (*a).dx += dx.x;
+      (*b).dx += dx.y;
+
+      // Move out of each other.
+      if (axis == Right) {
+        (*a).x -= fabs(right((*a)) - left((*b)));
+      } else {
+        (*a).x += fabs(left((*a)) - right((*b)));
+      }
+    }
+  } else if ((*a).isCircle && (*b).isCircle) {
+    // TODO: x-direction is incorrect on vertical bounces.
+    Vector2 dx = getDV_DU((*a), (*b), false);
+    Vector2 dy = getDV_DU((*a), (*b), true);
+
+    (*a).dx += dx.x;
+    (*b).dx += dx.y;
+    (*a).dy += dy.x;
+    (*b).dy += dy.y;
+
+    // The code below simulates circle collisions really well,
+    // however the derivation of the physics is not stated nor directly trivial.
+    // Dynamic Circle-Circle Collision: https://ericleong.me/research/circle-circle/
+
+    // double distance = sqrt(pow((*a).x - (*b).x, 2) + pow((*a).y - (*b).y, 2));
+    // Vector2 norm = Vector2Scale((Vector2){(*b).x - (*a).x, (*b).y - (*a).y}, 1 / distance);
+    // double p = 2 * ((*a).dx * norm.x + (*a).dy * norm.y - (*b).dx * norm.x - (*b).dy * norm.y) /
+    //            ((*a).mass + (*b).mass);
+
+    // (*a).dx -= p * (*a).mass * norm.x;
+    // (*a).dy -= p * (*a).mass * norm.y;
+    // (*b).dx += p * (*b).mass * norm.x;
+    // (*b).dy += p * (*b).mass * norm.y;
+  }
+
+  return true;
+}
+
+// Respond to a and b if they are colliding. Returns false on a false positive, like AABB_respond.
+static bool AABB_collide(AABB_Object *a, AABB_Object *b) {
+  // Check if they are colliding.
+  if (!AABB_colliding((*a), (*b)))
+    return true;
+
+  PHASE_BEGIN(ResponsePhase);
+  bool keepGoing = AABB_respond(a, b);
+  PHASE_END();
+  return keepGoing;
+}
+
+typedef enum { RectangleShape = 0, CircleShape } ShapeKind;
+
+// Structure-of-arrays storage of every object, so each simulation pass only streams through the fields it uses.
+// Unlike AABB_Object, width and height are always the full extents, also for circles.
+typedef struct {
+  size_t count;
+  size_t capacity;
+  double *x;
+  double *y;
+  double *dx;
+  double *dy;
+  double *width;
+  double *height;
+  float *mass;
+  unsigned char *kind;
+  // Only needed for rendering.
+  Color *col;
+} AABB_World;
+
+void AABB_freeWorld(AABB_World *world) {
+  free(world->x);
+  free(world->y);
+  free(world->dx);
+  free(world->dy);
+  free(world->width);
+  free(world->height);
+  free(world->mass);
+  free(world->kind);
+  free(world->col);
+  *world = (AABB_World){0};
+}
+
+// Returns a world with every array NULL if an allocation failed.
+AABB_World AABB_createWorld(size_t capacity) {
+  AABB_World world = {.capacity = capacity};
+
+  world.x = (double *)calloc(capacity, sizeof(double));
+  world.y = (double *)calloc(capacity, sizeof(double));
+  world.dx = (double *)calloc(capacity, sizeof(double));
+  world.dy = (double *)calloc(capacity, sizeof(double));
+  world.width = (double *)calloc(capacity, sizeof(double));
+  world.height = (double *)calloc(capacity, sizeof(double));
+  world.mass = (float *)calloc(capacity, sizeof(float));
+  world.kind = (unsigned char *)calloc(capacity, sizeof(unsigned char));
+  world.col = (Color *)calloc(capacity, sizeof(Color));
+
+  if (!world.x || !world.y || !world.dx || !world.dy || !world.width || !world.height || !world.mass || !world.kind ||
+      !world.col) {
+    AABB_freeWorld(&world);
+  }
+
+  return world;
+}
+
+// ---------- Conversion to and from AABB_Object. ----------
+static void AABB_setObject(AABB_World *world, size_t i, AABB_Object a) {
+  world->x[i] = a.x;
+  world->y[i] = a.y;
+  world->dx[i] = a.dx;
+  world->dy[i] = a.dy;
+  world->width[i] = width(a);
+  world->height[i] = height(a);
+  world->mass[i] = a.mass;
+  world->kind[i] = a.isCircle ? CircleShape : RectangleShape;
+  world->col[i] = a.col;
+}
+
+// Copy count objects into the world, replacing its contents. The world must have room for them.
+void AABB_worldFromObjects(AABB_World *world, const AABB_Object obj[], size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    AABB_setObject(world, i, obj[i]);
+  }
+
+  world->count = count;
+}
+
+// Rebuild object i as an AABB_Object, e.g. for drawing it.
+AABB_Object AABB_worldObject(const AABB_World *world, size_t i) {
+  bool isCircle = world->kind[i] == CircleShape;
+
+  return (AABB_Object){world->x[i],
+                       world->y[i],
+                       isCircle ? world->width[i] / 2 : world->width[i],
+                       world->height[i],
+                       world->dx[i],
+                       world->dy[i],
+                       world->mass[i],
+                       world->col[i],
+                       isCircle};
+}
+
+// The world-space extents of object i, for the broadphase.
+Bounds AABB_worldBounds(const AABB_World *world, size_t i) {
+  return (Bounds){world->x[i], world->y[i], world->x[i] + world->width[i], world->y[i] + world->height[i]};
+}
+
+// Pass a pair of objects of the world to collide, AABB_collide or AABB_respond, writing back what the response changed.
+static bool AABB_collideInWorld(AABB_World *world, size_t i, size_t j, bool (*collide)(AABB_Object *, AABB_Object *)) {
+  AABB_Object a = AABB_worldObject(world, i);
+  AABB_Object b = AABB_worldObject(world, j);
+  bool keepGoing = collide(&a, &b);
+
+  world->x[i] = a.x;
+  world->y[i] = a.y;
+  world->dx[i] = a.dx;
+  world->dy[i] = a.dy;
+  world->x[j] = b.x;
+  world->y[j] = b.y;
+  world->dx[j] = b.dx;
+  world->dy[j] = b.dy;
+  return keepGoing;
+}
+
+// The passes below stream through a few arrays without branching on the shape, and restrict promises the arrays
+// never overlap, so the compiler can vectorize them.
+static void AABB_applyGravity(size_t count, double *restrict dy, float dt) {
+  for (size_t i = 0; i < count; i++) {
+    dy[i] += GRAVITY * dt;
+  }
+}
+
+static void AABB_bounceOffSideWalls(size_t count, double *restrict x, double *restrict dx, const double *restrict w) {
+  for (size_t i = 0; i < count; i++) {
+    // Clamp the object inside the walls, and bounce it if that moved it.
+    double inside = x[i] < 0 ? 0 : x[i];
+    inside = inside > WIDTH - w[i] ? WIDTH - w[i] : inside;
+
+    dx[i] = inside != x[i] ? -dx[i] : dx[i];
+    x[i] = inside;
+  }
+}
+
+static void AABB_bounceOffCeilingAndFloor(size_t count, double *restrict y, double *restrict dy,
+                                          const double *restrict h, float dt) {
+  for (size_t i = 0; i < count; i++) {
+    bool hitTop = y[i] < 0;
+    double vy = hitTop ? -dy[i] : dy[i];
+    double top = hitTop ? 0 : y[i];
+
+    // Check if collision with the floor is present in the next frame.
+    bool hitFloor = top + h[i] + vy * dt > HEIGHT;
+
+    // Figure out the speed at the exact time when the object and floor intersect.
+    // s = v_0 * t + a * t^2 / 2
+    double v_0 = vy - (GRAVITY * dt);
+    double s = HEIGHT - (top + h[i]);
+    double t = -((v_0 - sqrt(v_0 * v_0 + 2 * GRAVITY * s)) / GRAVITY);
+
+    // v = v_0 + a * t
+    double v = v_0 + GRAVITY * t;
+
+    dy[i] = hitFloor ? -v : vy;
+    y[i] = hitFloor ? HEIGHT - h[i] : top;
+  }
+}
+
+static void AABB_integrate(size_t count, double *restrict x, double *restrict y, const double *restrict dx,
+                           const double *restrict dy, float dt) {
+  for (size_t i = 0; i < count; i++) {
+    x[i] += dx[i] * dt;
+    y[i] += dy[i] * dt;
   }
+}
+
+// Test object i against every object after it. The boxes are screened a block at a time by the SIMD kernel, only
+// the ones touching i reach the narrowphase.
+static void AABB_collideWithLater(AABB_World *world, size_t i, OverlapKernel kernel) {
+  size_t count = world->count;
+  size_t j = i + 1;
+
+  while (j < count) {
+    Bounds a = {world->x[i], world->y[i], world->x[i] + world->width[i], world->y[i] + world->height[i]};
+    unsigned hits = 0;
+
+    // Skip ahead to the first block with a hit.
+    while (j < count) {
+      hits = j + kernel.lanes <= count
+                 ? kernel.test(a, world->x + j, world->y + j, world->width + j, world->height + j)
+                 : overlapScalar(a, world->x + j, world->y + j, world->width + j, world->height + j, count - j);
+
+      if (hits) {
+        break;
+      }
 
-  for (size_t i = 0; i < objSize; i++) {
-    // ---------- Check for collision with the walls. ----------
-    if (left(obj[i]) < 0) {
-      obj[i].dx = -obj[i].dx;
-      obj[i].x = 0;
+      j += kernel.lanes;
     }
 
-    if (right(obj[i]) > WIDTH) {
-      obj[i].dx = -obj[i].dx;
-      obj[i].x = WIDTH - width(obj[i]);
+    if (!hits) {
+      return;
     }
 
-    if (top(obj[i]) < 0) {
-      obj[i].dy = -obj[i].dy;
-      obj[i].y = 0;
+    j += __builtin_ctz(hits);
+
+    if (!AABB_collideInWorld(world, i, j, AABB_collide)) {
+      return;
     }
 
-    // Check if collision with the floor is present in the next frame.
-    if (bottom(obj[i]) + obj[i].dy * dt > HEIGHT) {
-      // Figure out the speed at the exact time when the object and floor intersect.
-      // s = v_0 * t + a * t^2 / 2
-      double v_0 = obj[i].dy - (GRAVITY * dt);
-      double s = HEIGHT - bottom(obj[i]);
-      double t = -((v_0 - sqrt(pow(v_0, 2) + 2 * GRAVITY * s)) / GRAVITY);
-
-      // v = v_0 + a * t
-      double v = v_0 + GRAVITY * t;
-
-      obj[i].dy = -v;
-      obj[i].y = HEIGHT - height(obj[i]);
+    // A response can move i, so the rest of the block is screened again from its new position.
+    j++;
+  }
+}
+
+// Test each pair and respond to it right away, so later tests see the earlier responses.
+static void AABB_collidePairs(AABB_World *world, const Broadphase *broadphase, bool useBroadphase,
+                              OverlapKernel kernel) {
+  for (size_t i = 0; i < world->count; i++) {
+    if (useBroadphase) {
+      for (size_t p = broadphase->pairStart[i]; p < broadphase->pairStart[i + 1]; p++) {
+        if (!AABB_collideInWorld(world, i, broadphase->pairs[p].b, AABB_collide))
+          break;
+      }
+    } else {
+      AABB_collideWithLater(world, i, kernel);
     }
+  }
+}
 
-    // TODO: make this work correctly with circle and circle-rectangle collisions.
-    // ---------- Check for collision with another object. ----------
-    // When colliding, they will bounce according to the law of conservation of momentum.
-    // Due to limitations in AABB collision detection and what-not, every object will
-    // bounce in the x- or y-axis, never at an angle. Therefore, the collision will be done
-    // according to their shapes, but with the calculations according to a rectangle.
-    for (size_t j = i + 1; j < objSize; j++) {
-      // Check if they are colliding.
-      if (!AABB_colliding(obj[i], obj[j]))
-        continue;
-
-      // Get the axis of bounce in regards to obj[i].
-      Side axis = rectangle_side(obj[i], obj[j]);
-
-      // ensure that they don't give a false positive
-      bool falsePositive = (axis == Top && obj[j].dy < obj[i].dy) || (axis == Bottom && obj[j].dy > obj[i].dy) ||
-                           (axis == Left && obj[j].dx < obj[i].dx) || (axis == Right && obj[j].dx > obj[i].dx);
-
-      if (falsePositive)
-        break;
+// ---------- Parallel narrowphase. ----------
+typedef struct {
+  const AABB_World *world;
+  const Broadphase *broadphase;
+  bool useBroadphase;
+  OverlapKernel kernel;
+  Narrowphase *narrowphase;
+} AABB_ContactSearch;
+
+// Collect the contacts of object i, in the order AABB_collidePairs would test them.
+// Returns false if a contact could not be stored.
+static bool AABB_findContactsOf(const AABB_ContactSearch *search, size_t i, ContactList *list) {
+  const AABB_World *world = search->world;
+  AABB_Object a = AABB_worldObject(world, i);
+  size_t count = world->count;
+
+  if (search->useBroadphase) {
+    for (size_t p = search->broadphase->pairStart[i]; p < search->broadphase->pairStart[i + 1]; p++) {
+      size_t j = search->broadphase->pairs[p].b;
+
+      if (AABB_colliding(a, AABB_worldObject(world, j)) && !Narrowphase_add(list, i, j)) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  Bounds bounds = AABB_worldBounds(world, i);
+  OverlapKernel kernel = search->kernel;
+
+  for (size_t j = i + 1; j < count; j += kernel.lanes) {
+    unsigned hits = j + kernel.lanes <= count
+                        ? kernel.test(bounds, world->x + j, world->y + j, world->width + j, world->height + j)
+                        : overlapScalar(bounds, world->x + j, world->y + j, world->width + j, world->height + j,
+                                        count - j);
+
+    for (; hits; hits &= hits - 1) {
+      size_t k = j + __builtin_ctz(hits);
+
+      if (AABB_colliding(a, AABB_worldObject(world, k)) && !Narrowphase_add(list, i, k)) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+static void AABB_findContactsOfChunks(void *context, size_t begin, size_t end) {
+  AABB_ContactSearch *search = (AABB_ContactSearch *)context;
+  const size_t *start = search->narrowphase->rangeStart;
 
-      if (!obj[i].isCircle && !obj[j].isCircle) {
-        // When hit on the y-axis, dy is changed and dx is constant.
-        if (axis == Top || axis == Bottom) {
-          Vector2 dy = getDV_DU(obj[i], obj[j], true);
-
-          // printf("VERTICAL: (%d)\n%.3f %.3f\n", obj[i].col.g, dy.x, dy.y);
-
-          obj[i].dy += dy.x;
-          obj[j].dy += dy.y;
-
-          // Move out of each other.
-          if (axis == Top) {
-            obj[i].y += fabs(top(obj[i]) - bottom(obj[j]));
-          } else {
-            obj[i].y -= fabs(bottom(obj[i]) - top(obj[j]));
-          }
-        } else {
-          // If not on the y-axis, then on the x-axis.
-          Vector2 dx = getDV_DU(obj[i], obj[j], false);
-
-          // printf("HORIZ: (%d)\n%.3f %.3f\n", obj[i].col.g, dx.x, dx.y);
-
-          obj[i].dx += dx.x;
-          obj[j].dx += dx.y;
-
-          // Move out of each other.
-          if (axis == Right) {
-            obj[i].x -= fabs(right(obj[i]) - left(obj[j]));
-          } else {
-            obj[i].x += fabs(left(obj[i]) - right(obj[j]));
-          }
-        }
-      } else if (obj[i].isCircle && obj[j].isCircle) {
-        // TODO: x-direction is incorrect on vertical bounces.
-        Vector2 dx = getDV_DU(obj[i], obj[j], false);
-        Vector2 dy = getDV_DU(obj[i], obj[j], true);
-
-        obj[i].dx += dx.x;
-        obj[j].dx += dx.y;
-        obj[i].dy += dy.x;
-        obj[j].dy += dy.y;
-
-        // The code below simulates circle collisions really well,
-        // however the derivation of the physics is not stated nor directly trivial.
-        // Dynamic Circle-Circle Collision: https://ericleong.me/research/circle-circle/
-
-        // double distance = sqrt(pow(obj[i].x - obj[j].x, 2) + pow(obj[i].y - obj[j].y, 2));
-        // Vector2 norm = Vector2Scale((Vector2){obj[j].x - obj[i].x, obj[j].y - obj[i].y}, 1 / distance);
-        // double p = 2 * (obj[i].dx * norm.x + obj[i].dy * norm.y - obj[j].dx * norm.x - obj[j].dy * norm.y) /
-        //            (obj[i].mass + obj[j].mass);
-
-        // obj[i].dx -= p * obj[i].mass * norm.x;
-        // obj[i].dy -= p * obj[i].mass * norm.y;
-        // obj[j].dx += p * obj[j].mass * norm.x;
-        // obj[j].dy += p * obj[j].mass * norm.y;
+  for (size_t chunk = begin; chunk < end; chunk++) {
+    for (size_t i = start[chunk]; i < start[chunk + 1]; i++) {
+      if (!AABB_findContactsOf(search, i, &search->narrowphase->contacts[chunk])) {
+        return;
       }
     }
+  }
+}
+
+// Test every pair on the workers. Returns false if a contact could not be stored.
+static bool AABB_findContacts(const AABB_World *world, const Broadphase *broadphase, bool useBroadphase,
+                              OverlapKernel kernel, Narrowphase *narrowphase) {
+  AABB_ContactSearch search = {world, broadphase, useBroadphase, kernel, narrowphase};
+
+  Narrowphase_partition(narrowphase, world->count, broadphase, useBroadphase);
+  return Narrowphase_run(narrowphase, AABB_findContactsOfChunks, &search);
+}
+
+typedef struct {
+  AABB_World *world;
+  bool *ended;
+} AABB_Resolution;
+
+// A false positive ends the contacts of its first object, as it ends that object's checks in AABB_collidePairs.
+static void AABB_resolveContact(void *context, CandidatePair contact) {
+  AABB_Resolution *resolution = (AABB_Resolution *)context;
 
-    // ---------- Check if they *will* collide. ----------
+  if (!resolution->ended[contact.a] && !AABB_collideInWorld(resolution->world, contact.a, contact.b, AABB_respond)) {
+    resolution->ended[contact.a] = true;
+  }
+}
 
-    // ---------- Iterate velocity per delta T (dt). ----------
-    obj[i].x += obj[i].dx * dt;
-    obj[i].y += obj[i].dy * dt;
+// Respond to the contacts in batches that share no object, each on the workers. If they could not be batched,
+// respond to them one by one in the order they were found, which gives the same results.
+static void AABB_resolveContacts(AABB_World *world, Narrowphase *narrowphase) {
+  if (Narrowphase_batch(narrowphase, world->count)) {
+    AABB_Resolution resolution = {world, narrowphase->ended};
+    Narrowphase_resolve(narrowphase, AABB_resolveContact, &resolution);
+    return;
   }
-}
\ No newline at end of file
+
+  size_t ended = SIZE_MAX;
+
+  for (size_t k = 0; k < narrowphase->chunkCount; k++) {
+    const ContactList *list = &narrowphase->contacts[k];
+
+    for (size_t c = 0; c < list->count; c++) {
+      CandidatePair contact = list->pairs[c];
+
+      if (contact.a != ended && !AABB_collideInWorld(world, contact.a, contact.b, AABB_respond)) {
+        ended = contact.a;
+      }
+    }
+  }
+}
+
+// ---------- Passes over a range of objects, so the workers can split them. ----------
+#define AABB_PASS_GRAIN 1024
+
+typedef struct {
+  AABB_World *world;
+  float dt;
+  Bounds *bounds;
+} AABB_Pass;
+
+static void AABB_applyGravityToRange(void *context, size_t begin, size_t end) {
+  AABB_Pass *pass = (AABB_Pass *)context;
+  AABB_applyGravity(end - begin, pass->world->dy + begin, pass->dt);
+}
+
+static void AABB_bounceRangeOffWalls(void *context, size_t begin, size_t end) {
+  AABB_Pass *pass = (AABB_Pass *)context;
+  AABB_World *world = pass->world;
+
+  AABB_bounceOffSideWalls(end - begin, world->x + begin, world->dx + begin, world->width + begin);
+  AABB_bounceOffCeilingAndFloor(end - begin, world->y + begin, world->dy + begin, world->height + begin, pass->dt);
+}
+
+static void AABB_boundsOfRange(void *context, size_t begin, size_t end) {
+  AABB_Pass *pass = (AABB_Pass *)context;
+
+  for (size_t i = begin; i < end; i++) {
+    pass->bounds[i] = AABB_worldBounds(pass->world, i);
+  }
+}
+
+static void AABB_integrateRange(void *context, size_t begin, size_t end) {
+  AABB_Pass *pass = (AABB_Pass *)context;
+  AABB_World *world = pass->world;
+
+  AABB_integrate(end - begin, world->x + begin, world->y + begin, world->dx + begin, world->dy + begin, pass->dt);
+}
+
+// Pass a BruteForce broadphase to test every pair of objects. With a narrowphase, every pass runs on its workers and
+// every pair is tested before any is responded to, and the results are the same for any number of workers. That is a
+// different simulation from the serial loop without one, which responds to each pair as soon as it is tested, so the
+// two do not agree.
+void AABB_simulate(AABB_World *world, float dt, Broadphase *broadphase, Narrowphase *narrowphase) {
+  size_t count = world->count;
+  OverlapKernel kernel = overlapKernel();
+  Workers *workers = narrowphase ? &narrowphase->workers : NULL;
+  AABB_Pass pass = {world, dt, NULL};
+
+  // Apply gravitational acceleration first before checking for collisions.
+  PHASE_BEGIN(GravityPhase);
+  Workers_parallelFor(workers, count, AABB_PASS_GRAIN, AABB_applyGravityToRange, &pass);
+
+  // ---------- Check for collision with the walls. ----------
+  PHASE_SWITCH(WallPhase);
+  Workers_parallelFor(workers, count, AABB_PASS_GRAIN, AABB_bounceRangeOffWalls, &pass);
+
+  // ---------- Check for collision with another object. ----------
+  PHASE_SWITCH(BroadphasePhase);
+  bool useBroadphase = false;
+
+  if (broadphase->mode != BruteForce) {
+    Bounds *bounds = Broadphase_bounds(broadphase, count);
+
+    if (bounds) {
+      pass.bounds = bounds;
+      Workers_parallelFor(workers, count, AABB_PASS_GRAIN, AABB_boundsOfRange, &pass);
+      useBroadphase = Broadphase_update(broadphase, count, workers);
+    }
+  }
+
+  PHASE_SWITCH(PairPhase);
+
+  if (narrowphase && AABB_findContacts(world, broadphase, useBroadphase, kernel, narrowphase)) {
+    PHASE_SWITCH(ResponsePhase);
+    AABB_resolveContacts(world, narrowphase);
+  } else {
+    // Without a narrowphase, or if a contact could not be stored, test and respond in one serial loop. For a staged
+    // tick that changes its results.
+    AABB_collidePairs(world, broadphase, useBroadphase, kernel);
+  }
+
+  // ---------- Iterate velocity per delta T (dt). ----------
+  PHASE_SWITCH(IntegratePhase);
+  Workers_parallelFor(workers, count, AABB_PASS_GRAIN, AABB_integrateRange, &pass);
+  PHASE_END();
+}
@@ -1,16 +1,46 @@
 // Separating Axis Theorem.
 
+#include <broadphase.h>
 #include <math.h>
+#include <narrowphase.h>
+#include <phases.h>
 #include <raymath.h>
 #include <utils.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// Polygons have at most this many vertices.
+#define SAT_MAX_VERTICES 8
+
+// 1 stores the vertices and normals inside each object, so a sweep over the objects reads memory linearly.
+// 0 keeps them in separate heap blocks per object. `make bench-layout` compares the two. Their tick times are within
+// noise of each other, so the pointer layout stays the default until the cache misses show the inline one is better.
+#ifndef SAT_INLINE_VERTICES
+#define SAT_INLINE_VERTICES 0
+#endif
+
 typedef struct {
+#if SAT_INLINE_VERTICES
+  Vector2 vertices[SAT_MAX_VERTICES];
+#else
   Vector2 *vertices;
+#endif
   size_t vertices_count;
   Vector2 position;
   Vector2 velocity;
   Color col;
   double mass;
+  // Unit normals of the edges, with parallel ones removed. The shapes never rotate, so they never change.
+#if SAT_INLINE_VERTICES
+  Vector2 normals[SAT_MAX_VERTICES];
+#else
+  Vector2 *normals;
+#endif
+  size_t normals_count;
+  // Bounds of the vertices relative to position, the world bounds are these moved by position.
+  Bounds local;
 } SAT_Object;
 
 typedef struct {
@@ -18,51 +48,52 @@ typedef struct {
   double max;
 } AxisRange;
 
-static double SAT_top(SAT_Object a) {
-  double min = a.position.y + a.vertices[0].y;
-
-  for (size_t i = 1; i < a.vertices_count; i++) {
-    min = fmin(min, a.position.y + a.vertices[i].y);
+// Clear an object and give it room for SAT_MAX_VERTICES vertices and normals.
+// Only the heap layout allocates, returns false if that failed.
+bool SAT_initObject(SAT_Object *a) {
+  *a = (SAT_Object){0};
+
+#if !SAT_INLINE_VERTICES
+  a->vertices = (Vector2 *)calloc(SAT_MAX_VERTICES, sizeof(Vector2));
+  a->normals = (Vector2 *)calloc(SAT_MAX_VERTICES, sizeof(Vector2));
+
+  if (!a->vertices || !a->normals) {
+    free(a->vertices);
+    free(a->normals);
+    // Leave nothing for SAT_freeObject to free a second time.
+    *a = (SAT_Object){0};
+    return false;
   }
+#endif
 
-  return min;
+  return true;
 }
 
-static double SAT_right(SAT_Object a) {
-  double max = a.position.x + a.vertices[0].x;
-
-  for (size_t i = 1; i < a.vertices_count; i++) {
-    max = fmax(max, a.position.x + a.vertices[i].x);
-  }
-
-  return max;
+// Free what SAT_initObject allocated.
+void SAT_freeObject(SAT_Object *a) {
+#if !SAT_INLINE_VERTICES
+  free(a->vertices);
+  free(a->normals);
+#endif
+  *a = (SAT_Object){0};
 }
 
-static double SAT_bottom(SAT_Object a) {
-  double max = a.position.y + a.vertices[0].y;
+// World bounds are the cached local bounds moved to the object's position, no vertices are visited.
+static double SAT_top(SAT_Object a) { return a.position.y + a.local.top; }
 
-  for (size_t i = 1; i < a.vertices_count; i++) {
-    max = fmax(max, a.position.y + a.vertices[i].y);
-  }
-
-  return max;
-}
+static double SAT_right(SAT_Object a) { return a.position.x + a.local.right; }
 
-static double SAT_left(SAT_Object a) {
-  double min = a.position.x + a.vertices[0].x;
+static double SAT_bottom(SAT_Object a) { return a.position.y + a.local.bottom; }
 
-  for (size_t i = 1; i < a.vertices_count; i++) {
-    min = fmin(min, a.position.x + a.vertices[i].x);
-  }
+static double SAT_left(SAT_Object a) { return a.position.x + a.local.left; }
 
-  return min;
-}
+static Bounds SAT_bounds(SAT_Object a) { return (Bounds){SAT_left(a), SAT_top(a), SAT_right(a), SAT_bottom(a)}; }
 
 static Vector2 vectorMiddle(Vector2 a, Vector2 b) { return (Vector2){(a.x + b.x) / 2.0f, (a.y + b.y) / 2.0f}; }
 
-static double SAT_width(SAT_Object a) { return SAT_right(a) - a.position.x; }
+static double SAT_width(SAT_Object a) { return a.local.right; }
 
-static double SAT_height(SAT_Object a) { return SAT_bottom(a) - a.position.y; }
+static double SAT_height(SAT_Object a) { return a.local.bottom; }
 
 Vector2 SAT_center(SAT_Object a) {
   Vector2 sum = (Vector2){0, 0};
@@ -94,25 +125,200 @@ static AxisRange projected_range(SAT_Object a, Vector2 normal) {
 // Check if there is a gap between the two ranges.
 static bool range_overlap(AxisRange a, AxisRange b) { return !(a.max < b.min || b.max < a.min); }
 
-static bool SAT_colliding(SAT_Object a, SAT_Object b) {
-  Vector2 *vertices = concatVector2Arrays(a.vertices, a.vertices_count, b.vertices, b.vertices_count);
-  size_t size = a.vertices_count + b.vertices_count;
+// Fill normals with the unit normal of each edge, skipping any that are parallel to one already found: an axis
+// and its opposite cast the same shadows. normals needs room for count vectors.
+// Returns the number of normals written.
+size_t SAT_edgeNormals(const Vector2 vertices[], size_t count, Vector2 normals[]) {
+  size_t found = 0;
 
-  // Loop through each edge.
-  for (size_t i = 0; i < size; i++) {
-    Vector2 edge = Vector2Subtract(vertices[(i + 1) % size], vertices[i]);
-    // Find its normal/perpendicular axis.
+  for (size_t i = 0; i < count; i++) {
+    Vector2 edge = Vector2Subtract(vertices[(i + 1) % count], vertices[i]);
     Vector2 normal = Vector2Normalize((Vector2){-edge.y, edge.x});
+    bool parallel = false;
+
+    // The cross product of two parallel unit vectors is zero.
+    for (size_t j = 0; j < found && !parallel; j++) {
+      parallel = fabs(normal.x * normals[j].y - normal.y * normals[j].x) < 1e-5;
+    }
+
+    if (!parallel) {
+      normals[found++] = normal;
+    }
+  }
+
+  return found;
+}
+
+// Cache what is derived from the vertices: the edge normals and the local bounds.
+// Call it once the vertices are set, and again whenever they change.
+void SAT_updateShape(SAT_Object *a) {
+  a->normals_count = SAT_edgeNormals(a->vertices, a->vertices_count, a->normals);
+
+  Bounds local = {a->vertices[0].x, a->vertices[0].y, a->vertices[0].x, a->vertices[0].y};
 
+  for (size_t i = 1; i < a->vertices_count; i++) {
+    local.left = fmin(local.left, a->vertices[i].x);
+    local.top = fmin(local.top, a->vertices[i].y);
+    local.right = fmax(local.right, a->vertices[i].x);
+    local.bottom = fmax(local.bottom, a->vertices[i].y);
+  }
+
+  a->local = local;
+}
+
+// Look for a gap between the shadows of a and b on each of shape's cached edge normals.
+static bool SAT_separatedOnAxesOf(SAT_Object shape, SAT_Object a, SAT_Object b) {
+  for (size_t i = 0; i < shape.normals_count; i++) {
     // Get each normal range of shape A and B.
     // If there is a gap between the normal ranges, there is no collision, else continue searching.
-    if (!range_overlap(projected_range(a, normal), projected_range(b, normal))) {
-      return false;
+    if (!range_overlap(projected_range(a, shape.normals[i]), projected_range(b, shape.normals[i]))) {
+      return true;
     }
   }
 
-  // If there is no gap, a collision is guaranteed.
-  return true;
+  return false;
+}
+
+// Reads the precomputed edge normals of both shapes, so a test neither allocates nor normalizes.
+static bool SAT_colliding(SAT_Object a, SAT_Object b) {
+  // If there is no gap on any edge normal of either shape, a collision is guaranteed.
+  return !SAT_separatedOnAxesOf(a, a, b) && !SAT_separatedOnAxesOf(b, a, b);
+}
+
+// ---------- SIMD projection kernels. ----------
+// They give the same verdicts as SAT_colliding: every projection is computed with the same float operations in the
+// same order, only several at a time. All of them read SAT_MAX_VERTICES vertices, which SAT_initObject guarantees.
+
+// Returns true if a separating axis was found, i.e. a and b are not colliding.
+typedef bool (*SAT_Separated)(const SAT_Object *a, const SAT_Object *b);
+
+typedef struct {
+  SAT_Separated separated;
+  const char *name;
+} SAT_Kernel;
+
+static bool SAT_separatedScalar(const SAT_Object *a, const SAT_Object *b) { return !SAT_colliding(*a, *b); }
+
+#if defined(__x86_64__) || defined(__i386__)
+// Project all vertices onto one axis, four vertices per register, then reduce the lanes to one range.
+__attribute__((target("sse2"))) static AxisRange SAT_projectedRangeSSE2(const SAT_Object *a, Vector2 normal) {
+  const float *vertices = (const float *)a->vertices;
+  __m128 px = _mm_set1_ps(a->position.x);
+  __m128 py = _mm_set1_ps(a->position.y);
+  __m128 nx = _mm_set1_ps(normal.x);
+  __m128 ny = _mm_set1_ps(normal.y);
+  __m128 count = _mm_set1_ps((float)a->vertices_count);
+  __m128 min = _mm_setzero_ps();
+  __m128 max = _mm_setzero_ps();
+
+  for (size_t block = 0; block < a->vertices_count; block += 4) {
+    // Split [x0 y0 x1 y1] [x2 y2 x3 y3] into [x0 x1 x2 x3] and [y0 y1 y2 y3].
+    __m128 lo = _mm_loadu_ps(vertices + 2 * block);
+    __m128 hi = _mm_loadu_ps(vertices + 2 * block + 4);
+    __m128 x = _mm_add_ps(px, _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+    __m128 y = _mm_add_ps(py, _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+    __m128 dot = _mm_add_ps(_mm_mul_ps(x, nx), _mm_mul_ps(y, ny));
+
+    if (block == 0) {
+      min = max = _mm_shuffle_ps(dot, dot, _MM_SHUFFLE(0, 0, 0, 0));
+    }
+
+    // Lanes past the last vertex are padding, replace them with the first vertex's projection.
+    __m128 index = _mm_add_ps(_mm_set1_ps((float)block), _mm_setr_ps(0, 1, 2, 3));
+    __m128 valid = _mm_cmplt_ps(index, count);
+    dot = _mm_or_ps(_mm_and_ps(valid, dot), _mm_andnot_ps(valid, min));
+
+    min = _mm_min_ps(min, dot);
+    max = _mm_max_ps(max, dot);
+  }
+
+  min = _mm_min_ps(min, _mm_shuffle_ps(min, min, _MM_SHUFFLE(1, 0, 3, 2)));
+  min = _mm_min_ps(min, _mm_shuffle_ps(min, min, _MM_SHUFFLE(2, 3, 0, 1)));
+  max = _mm_max_ps(max, _mm_shuffle_ps(max, max, _MM_SHUFFLE(1, 0, 3, 2)));
+  max = _mm_max_ps(max, _mm_shuffle_ps(max, max, _MM_SHUFFLE(2, 3, 0, 1)));
+
+  return (AxisRange){_mm_cvtss_f32(min), _mm_cvtss_f32(max)};
+}
+
+__attribute__((target("sse2"))) static bool SAT_separatedSSE2(const SAT_Object *a, const SAT_Object *b) {
+  const SAT_Object *shapes[2] = {a, b};
+
+  for (int s = 0; s < 2; s++) {
+    for (size_t i = 0; i < shapes[s]->normals_count; i++) {
+      Vector2 normal = shapes[s]->normals[i];
+
+      if (!range_overlap(SAT_projectedRangeSSE2(a, normal), SAT_projectedRangeSSE2(b, normal))) {
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+// Project every vertex of a onto eight axes at once, one axis per lane, so no horizontal reduction is needed.
+__attribute__((target("avx2"))) static void SAT_projectOnAxesAVX2(const SAT_Object *a, __m256 nx, __m256 ny,
+                                                                  __m256 *min, __m256 *max) {
+  for (size_t i = 0; i < a->vertices_count; i++) {
+    __m256 x = _mm256_set1_ps(a->position.x + a->vertices[i].x);
+    __m256 y = _mm256_set1_ps(a->position.y + a->vertices[i].y);
+    __m256 dot = _mm256_add_ps(_mm256_mul_ps(x, nx), _mm256_mul_ps(y, ny));
+
+    *min = i == 0 ? dot : _mm256_min_ps(*min, dot);
+    *max = i == 0 ? dot : _mm256_max_ps(*max, dot);
+  }
+}
+
+__attribute__((target("avx2"))) static bool SAT_separatedAVX2(const SAT_Object *a, const SAT_Object *b) {
+  // Unused lanes keep a zero axis, everything projects onto 0 there so it never separates.
+  float nx[2 * SAT_MAX_VERTICES] = {0};
+  float ny[2 * SAT_MAX_VERTICES] = {0};
+  size_t axes = 0;
+
+  for (size_t i = 0; i < a->normals_count; i++, axes++) {
+    nx[axes] = a->normals[i].x;
+    ny[axes] = a->normals[i].y;
+  }
+
+  for (size_t i = 0; i < b->normals_count; i++, axes++) {
+    nx[axes] = b->normals[i].x;
+    ny[axes] = b->normals[i].y;
+  }
+
+  for (size_t first = 0; first < axes; first += 8) {
+    __m256 x = _mm256_loadu_ps(nx + first);
+    __m256 y = _mm256_loadu_ps(ny + first);
+    __m256 minA, maxA, minB, maxB;
+
+    SAT_projectOnAxesAVX2(a, x, y, &minA, &maxA);
+    SAT_projectOnAxesAVX2(b, x, y, &minB, &maxB);
+
+    __m256 gap = _mm256_or_ps(_mm256_cmp_ps(maxA, minB, _CMP_LT_OQ), _mm256_cmp_ps(maxB, minA, _CMP_LT_OQ));
+
+    if (_mm256_movemask_ps(gap)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+#endif
+
+// Pick the widest kernel this CPU supports, asking CPUID through the compiler's builtin.
+SAT_Kernel SAT_kernel(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+
+  if (__builtin_cpu_supports("avx2")) {
+    return (SAT_Kernel){SAT_separatedAVX2, "avx2"};
+  }
+
+  if (__builtin_cpu_supports("sse2")) {
+    return (SAT_Kernel){SAT_separatedSSE2, "sse2"};
+  }
+#endif
+
+  return (SAT_Kernel){SAT_separatedScalar, "scalar"};
 }
 
 // find colliding side (vertex) by position of center
@@ -185,107 +391,301 @@ static double SAT_DuDvMagicNumber(double v_ii0, double u_ii0, double mass_1, dou
   return (2.0 * difference) / massSum;
 }
 
-void SAT_simulate(SAT_Object obj[], size_t amount, float dt) {
-  // Apply gravitational acceleration first before checking for collisions.
-  for (size_t i = 0; i < amount; i++) {
-    obj[i].velocity.y += GRAVITY * dt;
+// Bounce two colliding objects off each other along the normal of the side they hit.
+static void SAT_respond(SAT_Object obj[], size_t i, size_t j) {
+  SAT_Object *A = &obj[i];
+  SAT_Object *B = &obj[j];
+
+  Vector2 a = SAT_findOptimalNormal(*A, *B);
+
+  double A_iilength = SAT_project((*A).velocity, a);
+  Vector2 A_ii = Vector2Scale(a, A_iilength / Vector2Length(a));
+  Vector2 A_perp = SAT_perpendicular(A_ii, (*A).velocity);
+
+  double B_iilength = SAT_project((*B).velocity, a);
+  Vector2 B_ii = Vector2Scale(a, B_iilength / Vector2Length(a));
+  Vector2 B_perp = SAT_perpendicular(B_ii, (*B).velocity);
+
+  double coefficient = SAT_DuDvMagicNumber(A_iilength, B_iilength, (*A).mass, (*B).mass);
+  double new_speed_A = A_iilength - (*B).mass * coefficient;
+  double new_speed_B = B_iilength + (*A).mass * coefficient;
+
+  // v = |v|/|a| * a   ( parallel vectors )
+  Vector2 A_vel_res = Vector2Scale(a, new_speed_A / Vector2Length(a));
+  Vector2 B_vel_res = Vector2Scale(a, new_speed_B / Vector2Length(a));
+
+  Vector2 A_true_res = Vector2Add(A_perp, A_vel_res);
+  Vector2 B_true_res = Vector2Add(B_perp, B_vel_res);
+
+  (*A).velocity = A_true_res;
+  (*B).velocity = B_true_res;
+
+  // move object B distance away at same angle as "a" vector in order to ensure that they are not colliding next
+  // frame. Do this by finding the vertex which collided and find its distance (will point inside object A)
+  double currDist = 0;
+  double smallestDist = 10000;
+  int vertexSide = SAT_findSide(*A, *B);
+  Vector2 mid = vectorMiddle(Vector2Add((*A).vertices[vertexSide], (*A).position),
+                             Vector2Add((*A).vertices[(vertexSide + 1) % (*A).vertices_count], (*A).position));
+  for (int k = 0; k < (*B).vertices_count; k++) {
+    currDist = Vector2Distance(mid, Vector2Add((*B).vertices[k], (*B).position));
+    if (currDist < smallestDist) {
+      smallestDist = currDist;
+    }
   }
+  Vector2 moveoutthefuckingway = Vector2Scale(a, smallestDist / Vector2Length(a));
 
-  for (size_t i = 0; i < amount; i++) {
-    // ---------- Check for collision with the walls. ----------
-    if (SAT_left(obj[i]) < 0) {
-      obj[i].velocity.x = -obj[i].velocity.x;
-      obj[i].position.x -= SAT_left(obj[i]);
+  // move object
+  (*B).position = Vector2Add((*B).position, moveoutthefuckingway);
+}
+
+static void SAT_collide(SAT_Object obj[], size_t i, size_t j, SAT_Kernel kernel) {
+  if (!kernel.separated(&obj[i], &obj[j])) {
+    PHASE_BEGIN(ResponsePhase);
+    SAT_respond(obj, i, j);
+    PHASE_END();
+  }
+}
+
+// Bounce an object off the walls, and off the floor if it would go through it in the next frame.
+static void SAT_bounceOffWalls(SAT_Object *a, float dt) {
+  if (SAT_left(*a) < 0) {
+    a->velocity.x = -a->velocity.x;
+    a->position.x -= SAT_left(*a);
+  }
+
+  if (SAT_right(*a) > WIDTH) {
+    a->velocity.x = -a->velocity.x;
+    a->position.x = WIDTH - SAT_width(*a);
+  }
+
+  if (SAT_top(*a) < 0) {
+    a->velocity.y = -a->velocity.y;
+    a->position.y -= SAT_top(*a);
+  }
+  // Check if collision with the floor is present in the next frame.
+  if (SAT_bottom(*a) + a->velocity.y * dt > HEIGHT) {
+    // Figure out the speed at the exact time when the object and floor intersect.
+    // s = v_0 * t + a * t^2 / 2
+
+    if (HEIGHT - SAT_bottom(*a) < 0) { // if its already in the ground
+
+      // need to go backwards in time, get v_0 without knowing t. This method uses
+      // v_0 = sqrt(v^2-2sa)
+      double s = HEIGHT - SAT_bottom(*a);
+      double v_0 = sqrt(pow(a->velocity.y, 2) - 2 * s * GRAVITY);
+
+      a->velocity.y = -v_0;
+      a->position.y = HEIGHT - SAT_height(*a);
+    } else {
+
+      double v_0 = a->velocity.y - (GRAVITY * dt);
+      double s = HEIGHT - SAT_bottom(*a);
+      double t = -((v_0 - sqrt(pow(v_0, 2) + 2 * GRAVITY * s)) / GRAVITY);
+
+      // v = v_0 + a * t
+      double v = v_0 + GRAVITY * t;
+
+      a->velocity.y = -v;
+      a->position.y = HEIGHT - SAT_height(*a);
     }
+  }
+}
 
-    if (SAT_right(obj[i]) > WIDTH) {
-      obj[i].velocity.x = -obj[i].velocity.x;
-      obj[i].position.x = WIDTH - SAT_width(obj[i]);
+// Test object i against its candidate pairs, or every later object, and respond to each collision right away.
+static void SAT_collideWithLater(SAT_Object obj[], size_t amount, size_t i, const Broadphase *broadphase,
+                                 bool useBroadphase, SAT_Kernel kernel) {
+  if (useBroadphase) {
+    for (size_t p = broadphase->pairStart[i]; p < broadphase->pairStart[i + 1]; p++) {
+      SAT_collide(obj, i, broadphase->pairs[p].b, kernel);
     }
+  } else {
+    for (size_t j = i + 1; j < amount; j++) {
+      SAT_collide(obj, i, j, kernel);
+    }
+  }
+}
 
-    if (SAT_top(obj[i]) < 0) {
-      obj[i].velocity.y = -obj[i].velocity.y;
-      obj[i].position.y -= SAT_top(obj[i]);
+// ---------- Parallel narrowphase. ----------
+typedef struct {
+  const SAT_Object *obj;
+  size_t amount;
+  const Broadphase *broadphase;
+  bool useBroadphase;
+  SAT_Kernel kernel;
+  Narrowphase *narrowphase;
+} SAT_ContactSearch;
+
+// Collect the contacts of each chunk's objects, in the order SAT_collideWithLater would test them.
+static void SAT_findContactsOfChunks(void *context, size_t begin, size_t end) {
+  SAT_ContactSearch *search = (SAT_ContactSearch *)context;
+  const SAT_Object *obj = search->obj;
+  const size_t *start = search->narrowphase->rangeStart;
+
+  for (size_t chunk = begin; chunk < end; chunk++) {
+    ContactList *list = &search->narrowphase->contacts[chunk];
+
+    for (size_t i = start[chunk]; i < start[chunk + 1]; i++) {
+      size_t first = search->useBroadphase ? search->broadphase->pairStart[i] : i + 1;
+      size_t last = search->useBroadphase ? search->broadphase->pairStart[i + 1] : search->amount;
+
+      for (size_t p = first; p < last; p++) {
+        size_t j = search->useBroadphase ? search->broadphase->pairs[p].b : p;
+
+        if (!search->kernel.separated(&obj[i], &obj[j]) && !Narrowphase_add(list, i, j)) {
+          return;
+        }
+      }
     }
-    // Check if collision with the floor is present in the next frame.
-    if (SAT_bottom(obj[i]) + obj[i].velocity.y * dt > HEIGHT) {
-      // Figure out the speed at the exact time when the object and floor intersect.
-      // s = v_0 * t + a * t^2 / 2
+  }
+}
 
-      if (HEIGHT - SAT_bottom(obj[i]) < 0) { // if its already in the ground
+// Test every pair on the workers. Returns false if a contact could not be stored.
+static bool SAT_findContacts(const SAT_Object obj[], size_t amount, const Broadphase *broadphase, bool useBroadphase,
+                             SAT_Kernel kernel, Narrowphase *narrowphase) {
+  SAT_ContactSearch search = {obj, amount, broadphase, useBroadphase, kernel, narrowphase};
 
-        // need to go backwards in time, get v_0 without knowing t. This method uses
-        // v_0 = sqrt(v^2-2sa)
-        double s = HEIGHT - SAT_bottom(obj[i]);
-        double v_0 = sqrt(pow(obj[i].velocity.y, 2) - 2 * s * GRAVITY);
+  Narrowphase_partition(narrowphase, amount, broadphase, useBroadphase);
+  return Narrowphase_run(narrowphase, SAT_findContactsOfChunks, &search);
+}
 
-        obj[i].velocity.y = -v_0;
-        obj[i].position.y = HEIGHT - SAT_height(obj[i]);
-      } else {
+static void SAT_resolveContact(void *context, CandidatePair contact) {
+  SAT_respond((SAT_Object *)context, contact.a, contact.b);
+}
 
-        double v_0 = obj[i].velocity.y - (GRAVITY * dt);
-        double s = HEIGHT - SAT_bottom(obj[i]);
-        double t = -((v_0 - sqrt(pow(v_0, 2) + 2 * GRAVITY * s)) / GRAVITY);
+// Respond to the contacts in batches that share no object, each on the workers. If they could not be batched,
+// respond to them one by one in the order they were found, which gives the same results.
+static void SAT_resolveContacts(SAT_Object obj[], size_t amount, Narrowphase *narrowphase) {
+  if (Narrowphase_batch(narrowphase, amount)) {
+    Narrowphase_resolve(narrowphase, SAT_resolveContact, obj);
+    return;
+  }
 
-        // v = v_0 + a * t
-        double v = v_0 + GRAVITY * t;
+  for (size_t k = 0; k < narrowphase->chunkCount; k++) {
+    const ContactList *list = &narrowphase->contacts[k];
 
-        obj[i].velocity.y = -v;
-        obj[i].position.y = HEIGHT - SAT_height(obj[i]);
-      }
+    for (size_t c = 0; c < list->count; c++) {
+      SAT_respond(obj, list->pairs[c].a, list->pairs[c].b);
     }
+  }
+}
 
-    // check for collision between objects
-    for (int j = i + 1; j < amount; j++) {
-      SAT_Object *A = &obj[i];
-      SAT_Object *B = &obj[j];
-      if (!SAT_colliding(*A, *B))
-        continue;
-
-      Vector2 a = SAT_findOptimalNormal(*A, *B);
-
-      double A_iilength = SAT_project((*A).velocity, a);
-      Vector2 A_ii = Vector2Scale(a, A_iilength / Vector2Length(a));
-      Vector2 A_perp = SAT_perpendicular(A_ii, (*A).velocity);
-
-      double B_iilength = SAT_project((*B).velocity, a);
-      Vector2 B_ii = Vector2Scale(a, B_iilength / Vector2Length(a));
-      Vector2 B_perp = SAT_perpendicular(B_ii, (*B).velocity);
-
-      double coefficient = SAT_DuDvMagicNumber(A_iilength, B_iilength, (*A).mass, (*B).mass);
-      double new_speed_A = A_iilength - (*B).mass * coefficient;
-      double new_speed_B = B_iilength + (*A).mass * coefficient;
-
-      // v = |v|/|a| * a   ( parallel vectors )
-      Vector2 A_vel_res = Vector2Scale(a, new_speed_A / Vector2Length(a));
-      Vector2 B_vel_res = Vector2Scale(a, new_speed_B / Vector2Length(a));
-
-      Vector2 A_true_res = Vector2Add(A_perp, A_vel_res);
-      Vector2 B_true_res = Vector2Add(B_perp, B_vel_res);
-
-      (*A).velocity = A_true_res;
-      (*B).velocity = B_true_res;
-
-      // move object B distance away at same angle as "a" vector in order to ensure that they are not colliding next
-      // frame. Do this by finding the vertex which collided and find its distance (will point inside object A)
-      double currDist = 0;
-      double smallestDist = 10000;
-      int vertexSide = SAT_findSide(*A, *B);
-      Vector2 mid = vectorMiddle(Vector2Add((*A).vertices[vertexSide], (*A).position),
-                                 Vector2Add((*A).vertices[(vertexSide + 1) % (*A).vertices_count], (*A).position));
-      for (int k = 0; k < (*B).vertices_count; k++) {
-        currDist = Vector2Distance(mid, Vector2Add((*B).vertices[k], (*B).position));
-        if (currDist < smallestDist) {
-          smallestDist = currDist;
-        }
-      }
-      Vector2 moveoutthefuckingway = Vector2Scale(a, smallestDist / Vector2Length(a));
+// ---------- Passes over a range of objects, so the workers can split them. ----------
+#define SAT_PASS_GRAIN 256
+
+typedef struct {
+  SAT_Object *obj;
+  float dt;
+  Bounds *bounds;
+} SAT_Pass;
+
+static void SAT_applyGravityToRange(void *context, size_t begin, size_t end) {
+  SAT_Pass *pass = (SAT_Pass *)context;
+
+  for (size_t i = begin; i < end; i++) {
+    pass->obj[i].velocity.y += GRAVITY * pass->dt;
+  }
+}
+
+static void SAT_boundsOfRange(void *context, size_t begin, size_t end) {
+  SAT_Pass *pass = (SAT_Pass *)context;
+
+  for (size_t i = begin; i < end; i++) {
+    pass->bounds[i] = SAT_bounds(pass->obj[i]);
+  }
+}
+
+static void SAT_bounceRangeOffWalls(void *context, size_t begin, size_t end) {
+  SAT_Pass *pass = (SAT_Pass *)context;
+
+  for (size_t i = begin; i < end; i++) {
+    SAT_bounceOffWalls(&pass->obj[i], pass->dt);
+  }
+}
+
+static void SAT_integrateRange(void *context, size_t begin, size_t end) {
+  SAT_Pass *pass = (SAT_Pass *)context;
+
+  for (size_t i = begin; i < end; i++) {
+    pass->obj[i].position = Vector2Add(pass->obj[i].position, Vector2Scale(pass->obj[i].velocity, pass->dt));
+  }
+}
+
+// Go through the phases after the broadphase one at a time over every object, each on the workers: pair tests,
+// responses and integration. The walls were already done before the broadphase.
+static void SAT_simulateStages(SAT_Object obj[], size_t amount, float dt, const Broadphase *broadphase,
+                               bool useBroadphase, SAT_Kernel kernel, Narrowphase *narrowphase) {
+  SAT_Pass pass = {obj, dt, NULL};
 
-      // move object
-      (*B).position = Vector2Add((*B).position, moveoutthefuckingway);
+  PHASE_SWITCH(PairPhase);
+  if (SAT_findContacts(obj, amount, broadphase, useBroadphase, kernel, narrowphase)) {
+    PHASE_SWITCH(ResponsePhase);
+    SAT_resolveContacts(obj, amount, narrowphase);
+  } else {
+    // A contact could not be stored, test and respond in one serial loop instead, which changes this tick's results.
+    for (size_t i = 0; i < amount; i++) {
+      SAT_collideWithLater(obj, amount, i, broadphase, useBroadphase, kernel);
     }
+  }
+
+  PHASE_SWITCH(IntegratePhase);
+  Workers_parallelFor(&narrowphase->workers, amount, SAT_PASS_GRAIN, SAT_integrateRange, &pass);
+}
+
+// Pass a BruteForce broadphase to test every pair of objects. With a narrowphase, every pass runs on its workers and
+// every pair is tested before any is responded to, and the results are the same for any number of workers. That is a
+// different simulation from the serial loop without one, which bounces each object off the walls and responds to each
+// pair as soon as it is reached, so the two do not agree.
+void SAT_simulate(SAT_Object obj[], size_t amount, float dt, Broadphase *broadphase, Narrowphase *narrowphase) {
+  SAT_Kernel kernel = SAT_kernel();
+  Workers *workers = narrowphase ? &narrowphase->workers : NULL;
+  SAT_Pass pass = {obj, dt, NULL};
+
+  // Apply gravitational acceleration first before checking for collisions.
+  PHASE_BEGIN(GravityPhase);
+  Workers_parallelFor(workers, amount, SAT_PASS_GRAIN, SAT_applyGravityToRange, &pass);
+
+  // The staged passes bounce every object off the walls first, so the candidate pairs come from the same positions
+  // the pairs are tested at.
+  if (narrowphase) {
+    PHASE_SWITCH(WallPhase);
+    Workers_parallelFor(workers, amount, SAT_PASS_GRAIN, SAT_bounceRangeOffWalls, &pass);
+  }
+
+  // Find the candidate pairs once, from where the objects are at the start of the frame.
+  PHASE_SWITCH(BroadphasePhase);
+  bool useBroadphase = false;
+
+  if (broadphase->mode != BruteForce) {
+    Bounds *bounds = Broadphase_bounds(broadphase, amount);
+
+    if (bounds) {
+      pass.bounds = bounds;
+      Workers_parallelFor(workers, amount, SAT_PASS_GRAIN, SAT_boundsOfRange, &pass);
+      useBroadphase = Broadphase_update(broadphase, amount, workers);
+    }
+  }
+
+  if (narrowphase) {
+    SAT_simulateStages(obj, amount, dt, broadphase, useBroadphase, kernel, narrowphase);
+    PHASE_END();
+    return;
+  }
+
+  // Each object goes through the walls, its pairs and its integration in turn, so the phases switch per object.
+  for (size_t i = 0; i < amount; i++) {
+    // ---------- Check for collision with the walls. ----------
+    PHASE_SWITCH(WallPhase);
+    SAT_bounceOffWalls(&obj[i], dt);
+
+    // check for collision between objects
+    PHASE_SWITCH(PairPhase);
+    SAT_collideWithLater(obj, amount, i, broadphase, useBroadphase, kernel);
 
     // ---------- Iterate velocity per delta T (dt). ----------
+    PHASE_SWITCH(IntegratePhase);
     obj[i].position = Vector2Add(obj[i].position, Vector2Scale(obj[i].velocity, dt));
   }
+
+  PHASE_END();
 }
\ No newline at end of file
@@ -0,0 +1,34 @@
+// Count the heap allocations made by the program's own objects.
+// The Makefile links with -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc, which sends those calls through the
+// __wrap_ functions below while __real_ still reaches the C library. The linker only rewrites the calls in the objects
+// it links, so allocations inside shared libraries (raylib, GL, or the C library's own, such as fopen's buffers) are
+// not counted.
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+#pragma once
+
+static atomic_size_t allocationCount;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+  atomic_fetch_add_explicit(&allocationCount, 1, memory_order_relaxed);
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+  atomic_fetch_add_explicit(&allocationCount, 1, memory_order_relaxed);
+  return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+  atomic_fetch_add_explicit(&allocationCount, 1, memory_order_relaxed);
+  return __real_realloc(ptr, size);
+}
+
+// The number of allocations made so far, take the difference of two calls to count the ones in between.
+size_t allocations(void) { return atomic_load_explicit(&allocationCount, memory_order_relaxed); }
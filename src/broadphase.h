@@ -0,0 +1,157 @@
+// Broadphase: cheaply find the pairs of objects that might collide, so that the narrowphase only tests those.
+
+#include <bvh.h>
+#include <common.h>
+#include <grid.h>
+#include <string.h>
+#include <sweep.h>
+#include <utils.h>
+#include <workers.h>
+
+#pragma once
+
+typedef enum { BruteForce = 0, UniformGrid, SweepAndPrune, DynamicBVH } BroadphaseMode;
+
+typedef struct {
+  BroadphaseMode mode;
+  // Filled in by the simulation every frame, one entry per object.
+  Bounds *bounds;
+  size_t boundsCapacity;
+  // The candidate pairs of object i are pairs[pairStart[i]..pairStart[i + 1]), ordered by the other object.
+  CandidatePair *pairs;
+  size_t pairCount;
+  size_t pairCapacity;
+  size_t *pairStart;
+  size_t pairStartCapacity;
+  // Unordered pairs as they come out of the broadphase.
+  CandidatePair *found;
+  size_t foundCapacity;
+  Grid grid;
+  Sweep sweep;
+  BVH bvh;
+} Broadphase;
+
+static const char *broadphaseName(BroadphaseMode mode) {
+  switch (mode) {
+  case UniformGrid:
+    return "grid";
+  case SweepAndPrune:
+    return "sap";
+  case DynamicBVH:
+    return "bvh";
+  default:
+    return "brute";
+  }
+}
+
+// The mode called name by broadphaseName. Returns false if there is none.
+bool broadphaseFromName(const char *name, BroadphaseMode *mode) {
+  for (BroadphaseMode candidate = BruteForce; candidate <= DynamicBVH; candidate++) {
+    if (strcmp(name, broadphaseName(candidate)) == 0) {
+      *mode = candidate;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+Broadphase Broadphase_create(BroadphaseMode mode) { return (Broadphase){.mode = mode}; }
+
+void Broadphase_free(Broadphase *broadphase) {
+  free(broadphase->bounds);
+  free(broadphase->pairs);
+  free(broadphase->pairStart);
+  free(broadphase->found);
+  Grid_free(&broadphase->grid);
+  Sweep_free(&broadphase->sweep);
+  BVH_free(&broadphase->bvh);
+  *broadphase = (Broadphase){.mode = broadphase->mode};
+}
+
+// Make room for the bounds of count objects and return them for the simulation to fill in.
+// Returns NULL if the allocation failed.
+Bounds *Broadphase_bounds(Broadphase *broadphase, size_t count) {
+  if (!reserveArray((void **)&broadphase->bounds, &broadphase->boundsCapacity, count, sizeof(Bounds))) {
+    return NULL;
+  }
+
+  return broadphase->bounds;
+}
+
+// Group the found pairs by their first object (a counting sort), so each object's pairs are tested in the same
+// order as the brute-force loop would.
+static bool Broadphase_groupPairs(Broadphase *broadphase, size_t count, size_t foundCount) {
+  if (!reserveArray((void **)&broadphase->pairStart, &broadphase->pairStartCapacity, count + 1, sizeof(size_t)) ||
+      !reserveArray((void **)&broadphase->pairs, &broadphase->pairCapacity, foundCount, sizeof(CandidatePair))) {
+    return false;
+  }
+
+  size_t *start = broadphase->pairStart;
+
+  for (size_t i = 0; i <= count; i++) {
+    start[i] = 0;
+  }
+
+  for (size_t p = 0; p < foundCount; p++) {
+    start[broadphase->found[p].a + 1]++;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    start[i + 1] += start[i];
+  }
+
+  for (size_t p = 0; p < foundCount; p++) {
+    broadphase->pairs[start[broadphase->found[p].a]++] = broadphase->found[p];
+  }
+
+  // Placing the pairs shifted every offset one object forward, shift them back.
+  for (size_t i = count; i > 0; i--) {
+    start[i] = start[i - 1];
+  }
+  start[0] = 0;
+
+  // Each object only has a handful of candidates, insertion sort them by the other object.
+  for (size_t i = 0; i < count; i++) {
+    for (size_t p = start[i] + 1; p < start[i + 1]; p++) {
+      CandidatePair pair = broadphase->pairs[p];
+      size_t q = p;
+
+      while (q > start[i] && broadphase->pairs[q - 1].b > pair.b) {
+        broadphase->pairs[q] = broadphase->pairs[q - 1];
+        q--;
+      }
+
+      broadphase->pairs[q] = pair;
+    }
+  }
+
+  broadphase->pairCount = foundCount;
+  return true;
+}
+
+// Find the candidate pairs from the bounds of count objects. Parts that can be split run on workers, if not NULL.
+// Returns false if the pairs could not be found, the caller should then fall back to testing every pair.
+bool Broadphase_update(Broadphase *broadphase, size_t count, Workers *workers) {
+  size_t foundCount = 0;
+  bool found = false;
+
+  switch (broadphase->mode) {
+  case UniformGrid:
+    found = Grid_findPairs(&broadphase->grid, broadphase->bounds, count, &broadphase->found, &foundCount,
+                           &broadphase->foundCapacity, workers);
+    break;
+  case SweepAndPrune:
+    found = Sweep_findPairs(&broadphase->sweep, broadphase->bounds, count, &broadphase->found, &foundCount,
+                          &broadphase->foundCapacity);
+    break;
+  case DynamicBVH:
+    found = BVH_findPairs(&broadphase->bvh, broadphase->bounds, count, &broadphase->found, &foundCount,
+                          &broadphase->foundCapacity);
+    break;
+  default:
+    break;
+  }
+
+  return found && Broadphase_groupPairs(broadphase, count, foundCount);
+}
@@ -0,0 +1,442 @@
+// Dynamic bounding volume hierarchy (AABB tree) broadphase.
+// Based on the dynamic tree in Box2D: https://box2d.org/files/ErinCatto_DynamicBVH_GDC2019.pdf
+
+#include <common.h>
+#include <math.h>
+#include <stdlib.h>
+#include <utils.h>
+
+#pragma once
+
+#define BVH_NULL (-1)
+// Leaves are fattened by this fraction of the object's largest extent...
+#define BVH_MARGIN_FACTOR 0.25
+// ...but never by less than this many meters, so tiny objects don't reinsert every frame.
+#define BVH_MIN_MARGIN 0.01
+
+typedef struct {
+  // Fattened bounds for leaves, the union of both children for inner nodes.
+  Bounds box;
+  int parent;
+  int left;
+  int right;
+  // The object a leaf holds, unused by inner nodes.
+  size_t object;
+  // Leaves have height 0.
+  int height;
+} BVHNode;
+
+typedef struct {
+  BVHNode *nodes;
+  size_t nodeCapacity;
+  size_t nodeCount;
+  int root;
+  // Released nodes are chained through their parent index.
+  int freeList;
+  // The leaf node of each object.
+  int *leaves;
+  size_t leavesCapacity;
+  size_t count;
+  int *stack;
+  size_t stackCapacity;
+} BVH;
+
+static bool BVH_isLeaf(const BVHNode *node) { return node->left == BVH_NULL; }
+
+static Bounds boundsUnion(Bounds a, Bounds b) {
+  return (Bounds){fmin(a.left, b.left), fmin(a.top, b.top), fmax(a.right, b.right), fmax(a.bottom, b.bottom)};
+}
+
+static bool boundsContain(Bounds outer, Bounds inner) {
+  return outer.left <= inner.left && outer.top <= inner.top && outer.right >= inner.right &&
+         outer.bottom >= inner.bottom;
+}
+
+// The 2D equivalent of the surface area heuristic: a bigger perimeter is more likely to be hit by a query.
+static double boundsPerimeter(Bounds a) { return 2 * ((a.right - a.left) + (a.bottom - a.top)); }
+
+static Bounds BVH_fatten(Bounds a) {
+  double margin = fmax(BVH_MIN_MARGIN, BVH_MARGIN_FACTOR * fmax(a.right - a.left, a.bottom - a.top));
+
+  return (Bounds){a.left - margin, a.top - margin, a.right + margin, a.bottom + margin};
+}
+
+void BVH_free(BVH *bvh) {
+  free(bvh->nodes);
+  free(bvh->leaves);
+  free(bvh->stack);
+  *bvh = (BVH){0};
+}
+
+// Returns BVH_NULL if the allocation failed.
+static int BVH_allocateNode(BVH *bvh) {
+  int node;
+
+  if (bvh->freeList != BVH_NULL) {
+    node = bvh->freeList;
+    bvh->freeList = bvh->nodes[node].parent;
+  } else {
+    if (!reserveArray((void **)&bvh->nodes, &bvh->nodeCapacity, bvh->nodeCount + 1, sizeof(BVHNode))) {
+      return BVH_NULL;
+    }
+
+    node = (int)bvh->nodeCount++;
+  }
+
+  bvh->nodes[node] = (BVHNode){.parent = BVH_NULL, .left = BVH_NULL, .right = BVH_NULL};
+  return node;
+}
+
+static void BVH_releaseNode(BVH *bvh, int node) {
+  bvh->nodes[node].parent = bvh->freeList;
+  bvh->nodes[node].height = -1;
+  bvh->freeList = node;
+}
+
+// Rotate the children of an unbalanced node so the tree stays roughly AVL balanced.
+// Returns the node that took its place.
+static int BVH_balance(BVH *bvh, int a) {
+  BVHNode *A = &bvh->nodes[a];
+
+  if (BVH_isLeaf(A) || A->height < 2) {
+    return a;
+  }
+
+  int b = A->left;
+  int c = A->right;
+  BVHNode *B = &bvh->nodes[b];
+  BVHNode *C = &bvh->nodes[c];
+  int balance = C->height - B->height;
+
+  if (balance > 1) {
+    // Rotate C up.
+    int f = C->left;
+    int g = C->right;
+    BVHNode *F = &bvh->nodes[f];
+    BVHNode *G = &bvh->nodes[g];
+
+    C->left = a;
+    C->parent = A->parent;
+    A->parent = c;
+
+    if (C->parent == BVH_NULL) {
+      bvh->root = c;
+    } else if (bvh->nodes[C->parent].left == a) {
+      bvh->nodes[C->parent].left = c;
+    } else {
+      bvh->nodes[C->parent].right = c;
+    }
+
+    // Keep the taller grandchild under C.
+    if (F->height > G->height) {
+      C->right = f;
+      A->right = g;
+      G->parent = a;
+      A->box = boundsUnion(B->box, G->box);
+      C->box = boundsUnion(A->box, F->box);
+      A->height = 1 + (B->height > G->height ? B->height : G->height);
+      C->height = 1 + (A->height > F->height ? A->height : F->height);
+    } else {
+      C->right = g;
+      A->right = f;
+      F->parent = a;
+      A->box = boundsUnion(B->box, F->box);
+      C->box = boundsUnion(A->box, G->box);
+      A->height = 1 + (B->height > F->height ? B->height : F->height);
+      C->height = 1 + (A->height > G->height ? A->height : G->height);
+    }
+
+    return c;
+  }
+
+  if (balance < -1) {
+    // Rotate B up.
+    int d = B->left;
+    int e = B->right;
+    BVHNode *D = &bvh->nodes[d];
+    BVHNode *E = &bvh->nodes[e];
+
+    B->left = a;
+    B->parent = A->parent;
+    A->parent = b;
+
+    if (B->parent == BVH_NULL) {
+      bvh->root = b;
+    } else if (bvh->nodes[B->parent].left == a) {
+      bvh->nodes[B->parent].left = b;
+    } else {
+      bvh->nodes[B->parent].right = b;
+    }
+
+    // Keep the taller grandchild under B.
+    if (D->height > E->height) {
+      B->right = d;
+      A->left = e;
+      E->parent = a;
+      A->box = boundsUnion(C->box, E->box);
+      B->box = boundsUnion(A->box, D->box);
+      A->height = 1 + (C->height > E->height ? C->height : E->height);
+      B->height = 1 + (A->height > D->height ? A->height : D->height);
+    } else {
+      B->right = e;
+      A->left = d;
+      D->parent = a;
+      A->box = boundsUnion(C->box, D->box);
+      B->box = boundsUnion(A->box, E->box);
+      A->height = 1 + (C->height > D->height ? C->height : D->height);
+      B->height = 1 + (A->height > E->height ? A->height : E->height);
+    }
+
+    return b;
+  }
+
+  return a;
+}
+
+// Walk up from a node, refitting boxes and heights and rebalancing on the way to the root.
+static void BVH_refitUpwards(BVH *bvh, int node) {
+  while (node != BVH_NULL) {
+    node = BVH_balance(bvh, node);
+
+    BVHNode *n = &bvh->nodes[node];
+    BVHNode *l = &bvh->nodes[n->left];
+    BVHNode *r = &bvh->nodes[n->right];
+
+    n->height = 1 + (l->height > r->height ? l->height : r->height);
+    n->box = boundsUnion(l->box, r->box);
+    node = n->parent;
+  }
+}
+
+// Returns false if the allocation failed.
+static bool BVH_insertLeaf(BVH *bvh, int leaf) {
+  if (bvh->root == BVH_NULL) {
+    bvh->root = leaf;
+    bvh->nodes[leaf].parent = BVH_NULL;
+    return true;
+  }
+
+  // ---------- Find the cheapest sibling. ----------
+  // Descend towards the child whose perimeter grows the least by adding the leaf.
+  Bounds box = bvh->nodes[leaf].box;
+  int index = bvh->root;
+
+  while (!BVH_isLeaf(&bvh->nodes[index])) {
+    BVHNode *n = &bvh->nodes[index];
+    double perimeter = boundsPerimeter(n->box);
+    double combined = boundsPerimeter(boundsUnion(n->box, box));
+
+    // Cost of pairing with this node, and the cost pushed down onto its children.
+    double cost = 2 * combined;
+    double inheritance = 2 * (combined - perimeter);
+
+    double childCost[2];
+    int children[2] = {n->left, n->right};
+
+    for (int c = 0; c < 2; c++) {
+      BVHNode *child = &bvh->nodes[children[c]];
+      double grown = boundsPerimeter(boundsUnion(child->box, box));
+
+      childCost[c] = BVH_isLeaf(child) ? grown + inheritance : grown - boundsPerimeter(child->box) + inheritance;
+    }
+
+    if (cost < childCost[0] && cost < childCost[1]) {
+      break;
+    }
+
+    index = childCost[0] < childCost[1] ? children[0] : children[1];
+  }
+
+  // ---------- Pair the leaf with its sibling under a new parent. ----------
+  int sibling = index;
+  int parent = BVH_allocateNode(bvh);
+
+  if (parent == BVH_NULL) {
+    return false;
+  }
+
+  int oldParent = bvh->nodes[sibling].parent;
+  BVHNode *p = &bvh->nodes[parent];
+
+  p->parent = oldParent;
+  p->box = boundsUnion(box, bvh->nodes[sibling].box);
+  p->height = bvh->nodes[sibling].height + 1;
+  p->left = sibling;
+  p->right = leaf;
+  bvh->nodes[sibling].parent = parent;
+  bvh->nodes[leaf].parent = parent;
+
+  if (oldParent == BVH_NULL) {
+    bvh->root = parent;
+  } else if (bvh->nodes[oldParent].left == sibling) {
+    bvh->nodes[oldParent].left = parent;
+  } else {
+    bvh->nodes[oldParent].right = parent;
+  }
+
+  BVH_refitUpwards(bvh, parent);
+  return true;
+}
+
+static void BVH_removeLeaf(BVH *bvh, int leaf) {
+  if (leaf == bvh->root) {
+    bvh->root = BVH_NULL;
+    return;
+  }
+
+  // The sibling takes the parent's place.
+  int parent = bvh->nodes[leaf].parent;
+  int grandParent = bvh->nodes[parent].parent;
+  int sibling = bvh->nodes[parent].left == leaf ? bvh->nodes[parent].right : bvh->nodes[parent].left;
+
+  bvh->nodes[sibling].parent = grandParent;
+  BVH_releaseNode(bvh, parent);
+
+  if (grandParent == BVH_NULL) {
+    bvh->root = sibling;
+    return;
+  }
+
+  if (bvh->nodes[grandParent].left == parent) {
+    bvh->nodes[grandParent].left = sibling;
+  } else {
+    bvh->nodes[grandParent].right = sibling;
+  }
+
+  BVH_refitUpwards(bvh, grandParent);
+}
+
+// Throw the tree away and insert every object again.
+static bool BVH_rebuild(BVH *bvh, const Bounds bounds[], size_t count) {
+  bvh->nodeCount = 0;
+  bvh->root = BVH_NULL;
+  bvh->freeList = BVH_NULL;
+  bvh->count = 0;
+
+  if (!reserveArray((void **)&bvh->leaves, &bvh->leavesCapacity, count, sizeof(int)) ||
+      !reserveArray((void **)&bvh->nodes, &bvh->nodeCapacity, 2 * count, sizeof(BVHNode))) {
+    return false;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    int leaf = BVH_allocateNode(bvh);
+
+    bvh->nodes[leaf].box = BVH_fatten(bounds[i]);
+    bvh->nodes[leaf].object = i;
+    bvh->leaves[i] = leaf;
+
+    if (!BVH_insertLeaf(bvh, leaf)) {
+      return false;
+    }
+  }
+
+  bvh->count = count;
+  return true;
+}
+
+// Update the tree with this frame's bounds, then query it for every pair of overlapping bounds.
+// A leaf is only reinserted once its object leaves the fattened box, so slow objects cost nothing to update.
+// A changed object count rebuilds the tree from scratch.
+// Returns false if an allocation failed.
+bool BVH_findPairs(BVH *bvh, const Bounds bounds[], size_t count, CandidatePair **pairs, size_t *pairCount,
+                   size_t *pairCapacity) {
+  *pairCount = 0;
+
+  if (bvh->count != count || bvh->nodes == NULL) {
+    if (!BVH_rebuild(bvh, bounds, count)) {
+      bvh->count = 0;
+      return false;
+    }
+  } else {
+    for (size_t i = 0; i < count; i++) {
+      int leaf = bvh->leaves[i];
+
+      if (boundsContain(bvh->nodes[leaf].box, bounds[i])) {
+        continue;
+      }
+
+      BVH_removeLeaf(bvh, leaf);
+      bvh->nodes[leaf].box = BVH_fatten(bounds[i]);
+
+      if (!BVH_insertLeaf(bvh, leaf)) {
+        bvh->count = 0;
+        return false;
+      }
+    }
+  }
+
+  if (bvh->root == BVH_NULL) {
+    return true;
+  }
+
+  // ---------- Query. ----------
+  // Descend the tree against itself: (a, a) looks for pairs inside a subtree, (a, b) for pairs between two
+  // subtrees. Whole subtrees are skipped as soon as their boxes stop overlapping, unlike querying leaf by leaf.
+  size_t top = 0;
+
+  if (!reserveArray((void **)&bvh->stack, &bvh->stackCapacity, 2, sizeof(int))) {
+    return false;
+  }
+
+  bvh->stack[top++] = bvh->root;
+  bvh->stack[top++] = bvh->root;
+
+  while (top > 0) {
+    int b = bvh->stack[--top];
+    int a = bvh->stack[--top];
+    BVHNode *A = &bvh->nodes[a];
+    BVHNode *B = &bvh->nodes[b];
+
+    // Popping a pair pushes at most three more.
+    if (!reserveArray((void **)&bvh->stack, &bvh->stackCapacity, top + 6, sizeof(int))) {
+      return false;
+    }
+
+    if (a == b) {
+      if (!BVH_isLeaf(A)) {
+        int pushes[6] = {A->left, A->left, A->right, A->right, A->left, A->right};
+
+        for (int k = 0; k < 6; k++) {
+          bvh->stack[top++] = pushes[k];
+        }
+      }
+
+      continue;
+    }
+
+    if (!boundsOverlap(A->box, B->box)) {
+      continue;
+    }
+
+    if (BVH_isLeaf(A) && BVH_isLeaf(B)) {
+      size_t i = A->object < B->object ? A->object : B->object;
+      size_t j = A->object < B->object ? B->object : A->object;
+
+      if (!boundsOverlap(bounds[i], bounds[j])) {
+        continue;
+      }
+
+      if (!reserveArray((void **)pairs, pairCapacity, *pairCount + 1, sizeof(CandidatePair))) {
+        return false;
+      }
+
+      (*pairs)[(*pairCount)++] = (CandidatePair){i, j};
+      continue;
+    }
+
+    // Split the taller subtree.
+    if (BVH_isLeaf(B) || (!BVH_isLeaf(A) && A->height >= B->height)) {
+      bvh->stack[top++] = A->left;
+      bvh->stack[top++] = b;
+      bvh->stack[top++] = A->right;
+      bvh->stack[top++] = b;
+    } else {
+      bvh->stack[top++] = a;
+      bvh->stack[top++] = B->left;
+      bvh->stack[top++] = a;
+      bvh->stack[top++] = B->right;
+    }
+  }
+
+  return true;
+}
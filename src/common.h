@@ -8,14 +8,66 @@
 #define HEIGHT (VIRTUAL_HEIGHT / SCALE)
 #define GRAVITY 9.82
 
+// 1 runs only the simulation, at a fixed dt with no window or drawing, for machines without a display.
+// Build it with `make headless`.
+#ifndef HEADLESS
+#define HEADLESS 0
+#endif
+
 #pragma once
 
+#include <stddef.h>
+#include <counters.h>
+#include <phases.h>
+#include <stdint.h>
+
 typedef struct {
-  double time;
+  // Wall-clock nanoseconds since the first recorded frame started.
+  uint64_t time;
   double fps;
+  // Nanoseconds spent in this frame's simulate call alone, without drawing or waiting for the next frame.
+  uint64_t tick;
+  // Nanoseconds of the tick spent in each phase of the simulation, 0 without PHASE_TIMING.
+  uint64_t phases[PHASE_COUNT];
+  // Hardware events counted during the tick, indexed by Counter.
+  uint64_t counters[COUNTER_COUNT];
+  // Heap allocations made while simulating this frame.
+  size_t allocations;
 } JSONDataPoint;
 
+// Tick times of one point of a sweep, in seconds.
+typedef struct {
+  double mean;
+  double median;
+  double p95;
+  double p99;
+  double stddev;
+} TickStats;
+
+typedef struct {
+  size_t objectCount;
+  TickStats ticks;
+} SweepPoint;
+
+// One algorithm's points of a scaling sweep, with the fitted exponent of tick time against object count.
+typedef struct {
+  const char *algorithm;
+  const char *broadphase;
+  SweepPoint *points;
+  size_t pointCount;
+  double exponent;
+} SweepSeries;
+
+// World-space extents of an object, shared by the broadphases.
+typedef struct {
+  double left;
+  double top;
+  double right;
+  double bottom;
+} Bounds;
+
+// Two object indices that a broadphase wants the narrowphase to test, with a < b.
 typedef struct {
-  int object_count;
-  JSONDataPoint *points;
-} JSONData;
+  size_t a;
+  size_t b;
+} CandidatePair;
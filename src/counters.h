@@ -0,0 +1,179 @@
+// Hardware performance counters around each tick, through Linux's perf_event_open.
+// Counters the kernel or CPU does not offer are skipped. Without any, the benchmark only records timings.
+// The counters only count the thread that opened them: with --threads, the work of the other workers is missed.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#pragma once
+
+typedef enum { CyclesCounter = 0, InstructionsCounter, L1DMissCounter, LLCMissCounter, BranchMissCounter } Counter;
+
+#define COUNTER_COUNT (BranchMissCounter + 1)
+
+static const char *COUNTER_NAMES[COUNTER_COUNT] = {"cycles", "instructions", "l1d_misses", "llc_misses",
+                                                   "branch_misses"};
+
+// Zero-initialize with leader -1 for a set with no counters open.
+typedef struct {
+  // Every counter is read at once through the first one that opened, -1 if none did.
+  int leader;
+  int fds[COUNTER_COUNT];
+  // The open counters in the order a group read returns them.
+  Counter order[COUNTER_COUNT];
+  size_t opened;
+} Counters;
+
+#ifdef __linux__
+static int Counters_openEvent(uint32_t type, uint64_t config, int leader) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  // With the times, a group the PMU could not always fit can be told apart from one that counted nothing.
+  attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  // Only this thread's own work, which also works at the default perf_event_paranoid level.
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.disabled = leader == -1;
+
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+}
+
+// A group read returns the number of counters, the time the group was enabled and the time it was actually counting,
+// then the values. Returns false if the read failed.
+static bool Counters_readGroup(const Counters *counters, uint64_t buffer[3 + COUNTER_COUNT]) {
+  return counters->leader != -1 &&
+         read(counters->leader, buffer, (3 + COUNTER_COUNT) * sizeof(uint64_t)) >= (ssize_t)(3 * sizeof(uint64_t));
+}
+#endif
+
+void Counters_close(Counters *counters) {
+#ifdef __linux__
+  for (size_t i = 0; i < counters->opened; i++) {
+    close(counters->fds[counters->order[i]]);
+  }
+#endif
+
+  *counters = (Counters){.leader = -1};
+}
+
+// Open and start every counter this machine offers. Returns false if there are none, or if they never get to count.
+bool Counters_open(Counters *counters) {
+  *counters = (Counters){.leader = -1};
+
+  for (size_t c = 0; c < COUNTER_COUNT; c++) {
+    counters->fds[c] = -1;
+  }
+
+#ifdef __linux__
+  const uint64_t l1dMisses = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                             ((uint64_t)PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  const struct {
+    uint32_t type;
+    uint64_t config;
+  } events[COUNTER_COUNT] = {{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+                             {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+                             {PERF_TYPE_HW_CACHE, l1dMisses},
+                             {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+                             {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES}};
+
+  for (size_t c = 0; c < COUNTER_COUNT; c++) {
+    int fd = Counters_openEvent(events[c].type, events[c].config, counters->leader);
+
+    if (fd == -1) {
+      continue;
+    }
+
+    if (counters->leader == -1) {
+      counters->leader = fd;
+    }
+
+    counters->fds[c] = fd;
+    counters->order[counters->opened++] = (Counter)c;
+  }
+
+  if (counters->leader != -1) {
+    ioctl(counters->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+
+    // A group the PMU cannot schedule opens fine but never counts. Give it some work, and drop it if it still has
+    // not run, so the benchmark records timings only instead of zeros.
+    uint64_t buffer[3 + COUNTER_COUNT];
+
+    for (volatile int spin = 0; spin < 100000; spin++) {
+    }
+
+    if (!Counters_readGroup(counters, buffer) || buffer[2] == 0) {
+      Counters_close(counters);
+    }
+  }
+#endif
+
+  return counters->opened > 0;
+}
+
+// Bit c is set if counter c is open.
+unsigned Counters_mask(const Counters *counters) {
+  unsigned mask = 0;
+
+  for (size_t i = 0; i < counters->opened; i++) {
+    mask |= 1u << counters->order[i];
+  }
+
+  return mask;
+}
+
+// The raw running totals of a group, with the time it was enabled and the time it was actually counting.
+typedef struct {
+  uint64_t values[COUNTER_COUNT];
+  uint64_t enabled;
+  uint64_t running;
+} CounterReading;
+
+// The running total of every open counter, 0 for the others.
+void Counters_read(const Counters *counters, CounterReading *reading) {
+  *reading = (CounterReading){0};
+
+#ifdef __linux__
+  uint64_t buffer[3 + COUNTER_COUNT];
+
+  if (!Counters_readGroup(counters, buffer)) {
+    return;
+  }
+
+  reading->enabled = buffer[1];
+  reading->running = buffer[2];
+
+  for (size_t i = 0; i < buffer[0] && i < counters->opened; i++) {
+    reading->values[counters->order[i]] = buffer[3 + i];
+  }
+#endif
+}
+
+// The counts between two readings. While the PMU is shared with other events, the group only counts part of the
+// time in between, and its counts are scaled up to the whole of it. A group that never counted in between gives 0.
+void Counters_difference(const CounterReading *before, const CounterReading *after, uint64_t counts[COUNTER_COUNT]) {
+  uint64_t enabled = after->enabled - before->enabled;
+  uint64_t running = after->running - before->running;
+
+  for (size_t c = 0; c < COUNTER_COUNT; c++) {
+    uint64_t value = after->values[c] >= before->values[c] ? after->values[c] - before->values[c] : 0;
+
+    if (running == 0) {
+      counts[c] = 0;
+    } else {
+      counts[c] = running < enabled ? (uint64_t)((double)value * enabled / running) : value;
+    }
+  }
+}
+
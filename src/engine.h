@@ -0,0 +1,33 @@
+// The interface every collision engine implements, so the benchmark can build, step, draw and time any of them the
+// same way. The engines are registered in engines.h.
+
+#include <broadphase.h>
+#include <common.h>
+#include <narrowphase.h>
+#include <scene.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#pragma once
+
+typedef struct {
+  // Used in the data file names, and case-insensitively on the command line.
+  const char *name;
+  // The broadphase used unless another one is asked for.
+  BroadphaseMode defaultBroadphase;
+  // Build the engine's own copy of count generated scene objects. Returns NULL if an allocation failed.
+  void *(*create)(const SceneObject scene[], size_t count);
+  // Advance the scene by dt seconds. Pass a BruteForce broadphase to test every pair of objects, and a narrowphase
+  // to test them on its workers before responding, or NULL to test and respond in one serial loop. The two are
+  // different simulations: any number of workers agree with each other, but not with the serial loop.
+  void (*step)(void *scene, float dt, Broadphase *broadphase, Narrowphase *narrowphase);
+  size_t (*count)(const void *scene);
+  // Write the world-space bounds of every object, bounds has room for count(scene) of them.
+  void (*bounds)(const void *scene, Bounds bounds[]);
+  // Write the position of every object, for drawing it on another thread. positions has room for count(scene).
+  void (*positions)(const void *scene, Vector2 positions[]);
+  // Draw every object at the given positions, between BeginDrawing and EndDrawing. Only reads what the simulation
+  // never changes, so it can run while the scene is stepped. NULL in the headless build.
+  void (*draw)(const void *scene, const Vector2 positions[]);
+  void (*destroy)(void *scene);
+} Engine;
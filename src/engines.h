@@ -0,0 +1,309 @@
+// The collision engines the benchmark can run: how each one builds its scene, and draws it in the window.
+
+#include <AABB.h>
+#include <SAT.h>
+#include <engine.h>
+#include <math.h>
+#include <raylib.h>
+#include <scene.h>
+#include <stdlib.h>
+#include <strings.h>
+
+#if !HEADLESS
+#include <rlgl.h>
+#endif
+
+#pragma once
+
+char TEXTDEBUGTMP[256];
+
+#if !HEADLESS
+static void drawAABB(AABB_Object a, int num) {
+  // TODO?: scale to window size.
+
+  // Convert physical meters -> pixels
+  if (a.isCircle) {
+    DrawCircle((a.x + a.width) * SCALE, (a.y + a.width) * SCALE, a.width * SCALE, a.col);
+  } else {
+    DrawRectangle(a.x * SCALE, a.y * SCALE, a.width * SCALE, a.height * SCALE, a.col);
+    // sprintf(TEXTDEBUGTMP, "%.3f %.3f", a.x, a.y);
+    // DrawText(TEXTDEBUGTMP, a.x * SCALE, (a.y + a.height) * SCALE + 16, 15, a.col);
+    // sprintf(TEXTDEBUGTMP, "%.3f %.3f", a.dx, a.dy);
+    // DrawText(TEXTDEBUGTMP, a.x * SCALE, (a.y + a.height) * SCALE + 36, 15, a.col);
+    // sprintf(TEXTDEBUGTMP, "%.3f - %.2f %.2f", a.mass, a.width, a.height);
+    // DrawText(TEXTDEBUGTMP, a.x * SCALE, (a.y + a.height) * SCALE + 56, 15, a.col);
+    // sprintf(TEXTDEBUGTMP, "%d %d %d %d", (int)a.col.r, (int)a.col.g, (int)a.col.b, (int)a.col.a);
+    // DrawText(TEXTDEBUGTMP, a.x * SCALE, (a.y + a.height) * SCALE + 76, 15, a.col);
+    // sprintf(TEXTDEBUGTMP, "Object #%d", num);
+    // DrawText(TEXTDEBUGTMP, a.x * SCALE, (a.y + a.height) * SCALE + 96, 15, a.col);
+  }
+}
+
+// Add the outline of a polygon to the current RL_LINES batch, two vertices per edge.
+static void drawSAT(const SAT_Object *a, Vector2 position) {
+  // Submit the batch first if the polygon would not fit in it. raylib before 5.0 drops the vertices that overflow.
+  rlCheckRenderBatchLimit(2 * (int)a->vertices_count);
+  rlColor4ub(a->col.r, a->col.g, a->col.b, a->col.a);
+
+  for (size_t i = 0; i < a->vertices_count; i++) {
+    // add position to vertex as offset, then scale by SCALE
+    Vector2 v1 = a->vertices[i];
+    Vector2 v2 = a->vertices[i + 1 < a->vertices_count ? i + 1 : 0];
+
+    rlVertex2f((v1.x + position.x) * SCALE, (v1.y + position.y) * SCALE);
+    rlVertex2f((v2.x + position.x) * SCALE, (v2.y + position.y) * SCALE);
+  }
+  // sprintf(TEXTDEBUGTMP, "%.3f - %.3f %.3f", a.mass, a.velocity.x, a.velocity.y);
+  // DrawText(TEXTDEBUGTMP, a.position.x * SCALE, (a.position.y + SAT_height(a)) * SCALE + 16, 15, a.col);
+  // DrawCircle(SAT_center(a).x * SCALE, SAT_center(a).y * SCALE, 5, WHITE);
+}
+#endif
+
+// Round objects are circles with the diameter of the smaller extent, the others rectangles.
+static void configureAABB(const SceneObject scene[], AABB_Object AABBs[], size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    SceneObject o = scene[i];
+
+    AABBs[i] = (AABB_Object){o.x,  o.y,  o.round ? fmin(o.width, o.height) / 2 : o.width, o.height,
+                             o.dx, o.dy, o.mass, o.col, o.round};
+  }
+}
+
+// Regular polygons, as wide as the smaller extent, centered in their bounding box.
+// Returns false if the vertices of an object could not be allocated.
+static bool configureSAT(const SceneObject scene[], SAT_Object SATs[], size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    SceneObject o = scene[i];
+    SAT_Object *object = &SATs[i];
+
+    if (!SAT_initObject(object)) {
+      return false;
+    }
+
+    int verticesCount = o.sides < SAT_MAX_VERTICES ? o.sides : SAT_MAX_VERTICES;
+    double radius = fmin(o.width, o.height) / 2;
+    double angIncrement = 2 * PI / (double)verticesCount;
+
+    for (int v = 0; v < verticesCount; v++) {
+      double angle = angIncrement * v;
+
+      object->vertices[v] = (Vector2){radius * cos(angle), radius * sin(angle)};
+    }
+
+    object->vertices_count = verticesCount;
+    SAT_updateShape(object);
+    object->position = (Vector2){o.x + radius, o.y + radius};
+    object->velocity = (Vector2){o.dx, o.dy};
+    object->col = o.col;
+    object->mass = o.mass;
+  }
+
+  return true;
+}
+
+// ---------- AABB. ----------
+// The simulation runs on the structure-of-arrays world, the objects are rebuilt from it for drawing.
+static void *AABB_createScene(const SceneObject scene[], size_t count) {
+  AABB_Object *objects = (AABB_Object *)calloc(count, sizeof(AABB_Object));
+  AABB_World *world = (AABB_World *)malloc(sizeof(AABB_World));
+
+  if (!objects || !world) {
+    free(objects);
+    free(world);
+    return NULL;
+  }
+
+  configureAABB(scene, objects, count);
+  *world = AABB_createWorld(count);
+
+  if (!world->x) {
+    free(objects);
+    free(world);
+    return NULL;
+  }
+
+  AABB_worldFromObjects(world, objects, count);
+  free(objects);
+  return world;
+}
+
+static void AABB_stepScene(void *scene, float dt, Broadphase *broadphase, Narrowphase *narrowphase) {
+  AABB_simulate((AABB_World *)scene, dt, broadphase, narrowphase);
+}
+
+static size_t AABB_sceneCount(const void *scene) { return ((const AABB_World *)scene)->count; }
+
+static void AABB_sceneBounds(const void *scene, Bounds bounds[]) {
+  const AABB_World *world = (const AABB_World *)scene;
+
+  for (size_t i = 0; i < world->count; i++) {
+    bounds[i] = AABB_worldBounds(world, i);
+  }
+}
+
+static void AABB_scenePositions(const void *scene, Vector2 positions[]) {
+  const AABB_World *world = (const AABB_World *)scene;
+
+  for (size_t i = 0; i < world->count; i++) {
+    positions[i] = (Vector2){(float)world->x[i], (float)world->y[i]};
+  }
+}
+
+#if !HEADLESS
+// The shapes and colours never change, only the positions come from the caller.
+static void AABB_drawScene(const void *scene, const Vector2 positions[]) {
+  const AABB_World *world = (const AABB_World *)scene;
+
+  for (size_t i = 0; i < world->count; i++) {
+    bool isCircle = world->kind[i] == CircleShape;
+    AABB_Object a = {.x = positions[i].x,
+                     .y = positions[i].y,
+                     .width = isCircle ? world->width[i] / 2 : world->width[i],
+                     .height = world->height[i],
+                     .col = world->col[i],
+                     .isCircle = isCircle};
+    drawAABB(a, i);
+  }
+}
+#endif
+
+static void AABB_destroyScene(void *scene) {
+  AABB_freeWorld((AABB_World *)scene);
+  free(scene);
+}
+
+// ---------- SAT. ----------
+typedef struct {
+  SAT_Object *objects;
+  size_t count;
+} SAT_Scene;
+
+static void *SAT_createScene(const SceneObject scene[], size_t count) {
+  SAT_Scene *sat = (SAT_Scene *)calloc(1, sizeof(SAT_Scene));
+  SAT_Object *objects = (SAT_Object *)calloc(count, sizeof(SAT_Object));
+
+  if (!sat || !objects) {
+    free(sat);
+    free(objects);
+    return NULL;
+  }
+
+  if (!configureSAT(scene, objects, count)) {
+    // The objects are zeroed, so freeing the ones never configured is harmless.
+    for (size_t i = 0; i < count; i++) {
+      SAT_freeObject(&objects[i]);
+    }
+
+    free(sat);
+    free(objects);
+    return NULL;
+  }
+
+  sat->objects = objects;
+  sat->count = count;
+  return sat;
+}
+
+static void SAT_stepScene(void *scene, float dt, Broadphase *broadphase, Narrowphase *narrowphase) {
+  SAT_Scene *sat = (SAT_Scene *)scene;
+
+  SAT_simulate(sat->objects, sat->count, dt, broadphase, narrowphase);
+}
+
+static size_t SAT_sceneCount(const void *scene) { return ((const SAT_Scene *)scene)->count; }
+
+static void SAT_sceneBounds(const void *scene, Bounds bounds[]) {
+  const SAT_Scene *sat = (const SAT_Scene *)scene;
+
+  for (size_t i = 0; i < sat->count; i++) {
+    bounds[i] = SAT_bounds(sat->objects[i]);
+  }
+}
+
+static void SAT_scenePositions(const void *scene, Vector2 positions[]) {
+  const SAT_Scene *sat = (const SAT_Scene *)scene;
+
+  for (size_t i = 0; i < sat->count; i++) {
+    positions[i] = sat->objects[i].position;
+  }
+}
+
+#if !HEADLESS
+// The vertices and colours never change, only the positions come from the caller.
+// Every edge goes into one RL_LINES batch instead of a DrawLineV call each. A new draw call only starts when the
+// vertex buffer is full, so a frame of thousands of polygons takes a handful.
+static void SAT_drawScene(const void *scene, const Vector2 positions[]) {
+  const SAT_Scene *sat = (const SAT_Scene *)scene;
+  SAT_Object *SATObjects = sat->objects;
+
+  rlBegin(RL_LINES);
+
+  for (size_t i = 0; i < sat->count; i++) {
+    drawSAT(&SATObjects[i], positions[i]);
+    // int vert = SAT_findSide(SATObjects[0], SATObjects[1]);
+    // Vector2 res = vectorMiddle(Vector2Add(A.vertices[vert], A.position),
+    //                            Vector2Add(A.vertices[(vert + 1) % A.vertices_count], A.position));
+    // DrawCircle(res.x * SCALE, res.y * SCALE, 3, RED);
+    // Vector2 vec = SAT_findOptimalNormal(SATObjects[0], SATObjects[1]);
+    // DrawCircle((res.x + vec.x) * SCALE, (res.y + vec.y) * SCALE, 3, RED);
+    // double viilength = SAT_project(A.velocity, vec);
+    // Vector2 vii = Vector2Scale(vec, viilength / Vector2Length(vec));
+    // Vector2 vperpen = SAT_perpendicular(vii, A.velocity);
+    // DrawCircle((res.x + vii.x) * SCALE, (res.y + vii.y) * SCALE, 3, BLUE);
+    // DrawCircle((res.x + vperpen.x) * SCALE, (res.y + vperpen.y) * SCALE, 3, GREEN);
+  }
+
+  rlEnd();
+}
+#endif
+
+static void SAT_destroyScene(void *scene) {
+  SAT_Scene *sat = (SAT_Scene *)scene;
+
+  for (size_t i = 0; i < sat->count; i++) {
+    SAT_freeObject(&sat->objects[i]);
+  }
+
+  free(sat->objects);
+  free(sat);
+}
+
+// ---------- Registry. ----------
+static const Engine AABB_ENGINE = {.name = "AABB",
+                                   .defaultBroadphase = SweepAndPrune,
+                                   .create = AABB_createScene,
+                                   .step = AABB_stepScene,
+                                   .count = AABB_sceneCount,
+                                   .bounds = AABB_sceneBounds,
+                                   .positions = AABB_scenePositions,
+#if !HEADLESS
+                                   .draw = AABB_drawScene,
+#endif
+                                   .destroy = AABB_destroyScene};
+
+static const Engine SAT_ENGINE = {.name = "SAT",
+                                  .defaultBroadphase = DynamicBVH,
+                                  .create = SAT_createScene,
+                                  .step = SAT_stepScene,
+                                  .count = SAT_sceneCount,
+                                  .bounds = SAT_sceneBounds,
+                                  .positions = SAT_scenePositions,
+#if !HEADLESS
+                                  .draw = SAT_drawScene,
+#endif
+                                  .destroy = SAT_destroyScene};
+
+// Every engine the benchmark knows, a sweep runs them in this order. Add new engines here.
+static const Engine *ENGINES[] = {&AABB_ENGINE, &SAT_ENGINE};
+#define ENGINE_COUNT (sizeof(ENGINES) / sizeof(ENGINES[0]))
+
+// The engine called name, ignoring case. Returns NULL if there is none.
+const Engine *findEngine(const char *name) {
+  for (size_t e = 0; e < ENGINE_COUNT; e++) {
+    if (strcasecmp(name, ENGINES[e]->name) == 0) {
+      return ENGINES[e];
+    }
+  }
+
+  return NULL;
+}
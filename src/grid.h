@@ -0,0 +1,174 @@
+// Uniform spatial grid broadphase.
+
+#include <common.h>
+#include <math.h>
+#include <utils.h>
+#include <workers.h>
+
+#pragma once
+
+// The grid never grows past this many cells per axis, however many objects there are.
+#define GRID_MAX_CELLS_PER_AXIS 1024
+// Objects a worker finds the cells of at a time.
+#define GRID_BIN_GRAIN 1024
+
+typedef struct {
+  size_t x0;
+  size_t y0;
+  size_t x1;
+  size_t y1;
+} CellRange;
+
+typedef struct {
+  size_t columns;
+  size_t rows;
+  double cellWidth;
+  double cellHeight;
+  // Objects binned into cell c are cellObjects[cellStart[c]..cellStart[c + 1]).
+  size_t *cellStart;
+  size_t cellStartCapacity;
+  size_t *cellObjects;
+  size_t cellObjectsCapacity;
+  CellRange *ranges;
+  size_t rangesCapacity;
+} Grid;
+
+static size_t Grid_clampCell(double coordinate, double cellSize, size_t cells) {
+  double cell = floor(coordinate / cellSize);
+
+  if (cell < 0) {
+    return 0;
+  }
+
+  return cell >= cells ? cells - 1 : (size_t)cell;
+}
+
+void Grid_free(Grid *grid) {
+  free(grid->cellStart);
+  free(grid->cellObjects);
+  free(grid->ranges);
+  *grid = (Grid){0};
+}
+
+typedef struct {
+  Grid *grid;
+  const Bounds *bounds;
+} GridBinning;
+
+// Find the range of cells each object's bounds touch.
+static void Grid_rangesOf(void *context, size_t begin, size_t end) {
+  GridBinning *binning = (GridBinning *)context;
+  Grid *grid = binning->grid;
+
+  for (size_t i = begin; i < end; i++) {
+    Bounds b = binning->bounds[i];
+    grid->ranges[i] = (CellRange){Grid_clampCell(b.left, grid->cellWidth, grid->columns),
+                                  Grid_clampCell(b.top, grid->cellHeight, grid->rows),
+                                  Grid_clampCell(b.right, grid->cellWidth, grid->columns),
+                                  Grid_clampCell(b.bottom, grid->cellHeight, grid->rows)};
+  }
+}
+
+// Bin every object into the cells its bounds touch, then emit each pair of overlapping bounds that share a cell.
+// Objects outside of the world are clamped into the border cells. The cells of each object are found on workers,
+// if not NULL.
+// Returns false if an allocation failed.
+bool Grid_findPairs(Grid *grid, const Bounds bounds[], size_t count, CandidatePair **pairs, size_t *pairCount,
+                    size_t *pairCapacity, Workers *workers) {
+  *pairCount = 0;
+
+  // Aim for about one object per cell, stretched to the world's aspect ratio.
+  double columns = ceil(sqrt((double)count * WIDTH / HEIGHT));
+  double rows = ceil(sqrt((double)count * HEIGHT / WIDTH));
+  grid->columns = (size_t)fmin(fmax(columns, 1), GRID_MAX_CELLS_PER_AXIS);
+  grid->rows = (size_t)fmin(fmax(rows, 1), GRID_MAX_CELLS_PER_AXIS);
+  grid->cellWidth = WIDTH / grid->columns;
+  grid->cellHeight = HEIGHT / grid->rows;
+
+  size_t cellCount = grid->columns * grid->rows;
+
+  if (!reserveArray((void **)&grid->cellStart, &grid->cellStartCapacity, cellCount + 1, sizeof(size_t)) ||
+      !reserveArray((void **)&grid->ranges, &grid->rangesCapacity, count, sizeof(CellRange))) {
+    return false;
+  }
+
+  GridBinning binning = {grid, bounds};
+  Workers_parallelFor(workers, count, GRID_BIN_GRAIN, Grid_rangesOf, &binning);
+
+  // ---------- Count the objects per cell. ----------
+  for (size_t c = 0; c <= cellCount; c++) {
+    grid->cellStart[c] = 0;
+  }
+
+  size_t entries = 0;
+
+  for (size_t i = 0; i < count; i++) {
+    CellRange r = grid->ranges[i];
+
+    for (size_t y = r.y0; y <= r.y1; y++) {
+      for (size_t x = r.x0; x <= r.x1; x++) {
+        grid->cellStart[y * grid->columns + x + 1]++;
+      }
+    }
+
+    entries += (r.x1 - r.x0 + 1) * (r.y1 - r.y0 + 1);
+  }
+
+  if (!reserveArray((void **)&grid->cellObjects, &grid->cellObjectsCapacity, entries, sizeof(size_t))) {
+    return false;
+  }
+
+  // ---------- Bin the objects. ----------
+  // Turn the counts into offsets, then fill each cell in ascending object order.
+  for (size_t c = 0; c < cellCount; c++) {
+    grid->cellStart[c + 1] += grid->cellStart[c];
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    CellRange r = grid->ranges[i];
+
+    for (size_t y = r.y0; y <= r.y1; y++) {
+      for (size_t x = r.x0; x <= r.x1; x++) {
+        grid->cellObjects[grid->cellStart[y * grid->columns + x]++] = i;
+      }
+    }
+  }
+
+  // Filling shifted every offset one cell forward, shift them back.
+  for (size_t c = cellCount; c > 0; c--) {
+    grid->cellStart[c] = grid->cellStart[c - 1];
+  }
+  grid->cellStart[0] = 0;
+
+  // ---------- Emit the pairs sharing a cell. ----------
+  for (size_t y = 0; y < grid->rows; y++) {
+    for (size_t x = 0; x < grid->columns; x++) {
+      size_t c = y * grid->columns + x;
+
+      for (size_t p = grid->cellStart[c]; p < grid->cellStart[c + 1]; p++) {
+        size_t a = grid->cellObjects[p];
+
+        for (size_t q = p + 1; q < grid->cellStart[c + 1]; q++) {
+          size_t b = grid->cellObjects[q];
+          CellRange ra = grid->ranges[a];
+          CellRange rb = grid->ranges[b];
+          size_t sharedX = ra.x0 > rb.x0 ? ra.x0 : rb.x0;
+          size_t sharedY = ra.y0 > rb.y0 ? ra.y0 : rb.y0;
+
+          // Two objects can share several cells, only the top-left shared cell reports them.
+          if (x != sharedX || y != sharedY || !boundsOverlap(bounds[a], bounds[b])) {
+            continue;
+          }
+
+          if (!reserveArray((void **)pairs, pairCapacity, *pairCount + 1, sizeof(CandidatePair))) {
+            return false;
+          }
+
+          (*pairs)[(*pairCount)++] = (CandidatePair){a, b};
+        }
+      }
+    }
+  }
+
+  return true;
+}
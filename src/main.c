@@ -1,3 +1,4 @@
+#include <inttypes.h>
 #include <math.h>
 #include <raylib.h>
 #include <stdio.h>
@@ -6,166 +7,462 @@
 #include <time.h>
 #include <utils.h>
 
-#include <AABB.h>
-#include <SAT.h>
+#include <allocations.h>
+#include <broadphase.h>
 #include <common.h>
+#include <engines.h>
+#include <options.h>
+#include <pthread.h>
+#include <snapshots.h>
+#include <stats.h>
+#include <timer.h>
+#include <trace.h>
 
-#define FRAMERATE 90
-#define MAXOBJECTS 1000000
 #define FRAMES_PER_AVERAGE 30
-#define IS_SIMULATING_SAT true // to switch between SAT and AABB
-#define IS_RECORDING_DATA true // for recording data or not
-#define DESIREDOBJECTS 800
-#define RUN_NUMBER 8
 
-char TEXTDEBUGTMP[256];
+// The data file of a run: JSON, or a binary trace with --trace.
+typedef struct {
+  bool binary;
+  DataStream json;
+  Trace trace;
+} DataFile;
+
+// Start the data file of a run in the output directory. Returns false if it could not be opened.
+static bool openData(DataFile *data, const Options *options, int run, uint64_t seed, unsigned counters) {
+  // Brute-force runs keep the original file names, other broadphases are tagged with their name.
+  char path[1024];
+  bool tagged = options->broadphase != BruteForce;
+  snprintf(path, sizeof(path), "%s/%s%s%s%s_run_%d.%s", options->output, options->engine->name,
+           tagged ? "_" : "", tagged ? broadphaseName(options->broadphase) : "", HEADLESS ? "_headless" : "", run,
+           options->trace ? "trace" : "json");
+  bool opened;
+  data->binary = options->trace;
+
+  if (data->binary) {
+    TraceHeader header = Trace_header();
+    header.counters = counters;
+    header.phaseTiming = PHASE_TIMING;
+    header.headless = HEADLESS;
+    header.run = run;
+    header.seed = seed;
+    header.objectCount = options->objects;
+    header.dt = options->dt;
+    header.threads = (uint32_t)options->threads;
+    header.tscGigahertz = Timer_TSCGigahertz();
+    snprintf(header.engine, sizeof(header.engine), "%s", options->engine->name);
+    snprintf(header.broadphase, sizeof(header.broadphase), "%s", broadphaseName(options->broadphase));
+    opened = Trace_open(&data->trace, path, &header);
+  } else {
+    opened = DataStream_open(&data->json, path, options->objects, PHASE_TIMING, counters);
+  }
+
+  if (!opened) {
+    fprintf(stderr, "Failed to open %s.\n", path);
+  }
 
-static void drawAABB(AABB_Object a, int num) {
-  // TODO?: scale to window size.
+  return opened;
+}
 
-  // Convert physical meters -> pixels
-  if (a.isCircle) {
-    DrawCircle((a.x + a.width) * SCALE, (a.y + a.width) * SCALE, a.width * SCALE, a.col);
+static void writeData(DataFile *data, const JSONDataPoint *point) {
+  if (data->binary) {
+    Trace_write(&data->trace, point);
   } else {
-    DrawRectangle(a.x * SCALE, a.y * SCALE, a.width * SCALE, a.height * SCALE, a.col);
-    // sprintf(TEXTDEBUGTMP, "%.3f %.3f", a.x, a.y);
-    // DrawText(TEXTDEBUGTMP, a.x * SCALE, (a.y + a.height) * SCALE + 16, 15, a.col);
-    // sprintf(TEXTDEBUGTMP, "%.3f %.3f", a.dx, a.dy);
-    // DrawText(TEXTDEBUGTMP, a.x * SCALE, (a.y + a.height) * SCALE + 36, 15, a.col);
-    // sprintf(TEXTDEBUGTMP, "%.3f - %.2f %.2f", a.mass, a.width, a.height);
-    // DrawText(TEXTDEBUGTMP, a.x * SCALE, (a.y + a.height) * SCALE + 56, 15, a.col);
-    // sprintf(TEXTDEBUGTMP, "%d %d %d %d", (int)a.col.r, (int)a.col.g, (int)a.col.b, (int)a.col.a);
-    // DrawText(TEXTDEBUGTMP, a.x * SCALE, (a.y + a.height) * SCALE + 76, 15, a.col);
-    // sprintf(TEXTDEBUGTMP, "Object #%d", num);
-    // DrawText(TEXTDEBUGTMP, a.x * SCALE, (a.y + a.height) * SCALE + 96, 15, a.col);
+    DataStream_write(&data->json, point);
   }
 }
 
-static void drawSAT(SAT_Object a) {
-  // Draw lines only, no fill.
-  Vector2 v1;
-  Vector2 v2;
+// Returns false if any write failed.
+static bool closeData(DataFile *data) {
+  return data->binary ? Trace_close(&data->trace) : DataStream_close(&data->json);
+}
 
-  for (size_t i = 0; i < a.vertices_count - 1; i++) {
-    // add position to vertex as offset, then scale by SCALE
-    v1 = Vector2Scale(Vector2Add(a.vertices[i], a.position), SCALE);
-    v2 = Vector2Scale(Vector2Add(a.vertices[i + 1], a.position), SCALE);
+// Print how much of the elapsed tick time each worker spent running chunks, and how many chunks it stole.
+static void printUtilization(const Workers *workers, uint64_t elapsed) {
+  printf("Workers busy:");
 
-    DrawLineV(v1, v2, a.col);
+  for (size_t w = 0; w < workers->count; w++) {
+    WorkerStats stats = Workers_stats(workers, w);
+    printf(" %zu: %.0f%% (%" PRIu64 " stolen)", w, 100 * Workers_busyNanoseconds(workers, w) / (elapsed ? elapsed : 1),
+           stats.steals);
   }
-  // sprintf(TEXTDEBUGTMP, "%.3f - %.3f %.3f", a.mass, a.velocity.x, a.velocity.y);
-  // DrawText(TEXTDEBUGTMP, a.position.x * SCALE, (a.position.y + SAT_height(a)) * SCALE + 16, 15, a.col);
 
-  DrawLineV(Vector2Scale(Vector2Add(a.vertices[a.vertices_count - 1], a.position), SCALE),
-            Vector2Scale(Vector2Add(a.vertices[0], a.position), SCALE), a.col);
-  // DrawCircle(SAT_center(a).x * SCALE, SAT_center(a).y * SCALE, 5, WHITE);
+  printf("\n");
 }
 
-// Remove in production?
-static float rando(float min, float max) {
-  int generated = (float)((rand() % (int)(max * 100 - min * 100 + 1)) + min * 100);
+// What a run records of its ticks.
+typedef struct {
+  int run;
+  // Ticks 2..lastFrame - 1 are recorded, the first two only warm up.
+  int lastFrame;
+  // Every point goes straight to the data file as it is recorded.
+  DataFile data;
+  bool recording;
+  // If not NULL, gets the time of every recorded tick in seconds.
+  double *ticks;
+  uint64_t startTime;
+  uint64_t tickTotal;
+} Recorder;
+
+// Count tick number frame of the run, which took tick nanoseconds and made tickAllocations allocations, with the
+// counts read around it. Closes the data file after the last recorded tick.
+static void recordTick(Recorder *recorder, int frame, uint64_t tick, float fps, size_t tickAllocations,
+                       const uint64_t tickCounts[]) {
+  if (frame > 1 && frame < recorder->lastFrame) {
+    recorder->tickTotal += tick;
+
+    if (recorder->ticks) {
+      recorder->ticks[frame - 2] = tick / 1e9;
+    }
+  }
+
+  if (frame > 1 && frame < recorder->lastFrame && recorder->recording) {
+    JSONDataPoint point = {
+        .time = Timer_nanoseconds() - recorder->startTime, .fps = fps, .tick = tick, .allocations = tickAllocations};
+
+    for (size_t p = 0; p < PHASE_COUNT; p++) {
+      point.phases[p] = Phase_nanoseconds(p);
+    }
+
+    for (size_t c = 0; c < COUNTER_COUNT; c++) {
+      point.counters[c] = tickCounts[c];
+    }
+
+    writeData(&recorder->data, &point);
+  }
+
+  if (frame == recorder->lastFrame && recorder->recording) {
+    recorder->recording = false;
 
-  return (float)(generated) / 100.0F;
+    if (!closeData(&recorder->data)) {
+      fprintf(stderr, "Failed to write the data of run %d.\n", recorder->run);
+    }
+  }
 }
 
-static void configureAABB(AABB_Object *AABBs[], size_t *realObjCount, size_t desiredObjCount) {
-  Color col = (Color){0, 0, 0, 255};
-
-  for (size_t i = 0; i < desiredObjCount; i++) {
-    col.r = rando(50, 255);
-    col.g = rando(50, 255);
-    col.b = rando(50, 255);
-    (*AABBs)[i] = (AABB_Object){rando(1, 5),
-                                rando(1, 5),
-                                fmax(1 / SCALE, 3 * rando(0.5, 1) / pow((double)desiredObjCount, 0.5)),
-                                fmax(1 / SCALE, 3 * rando(0.5, 1) / pow((double)desiredObjCount, 0.5)),
-                                rando(-1, 2),
-                                rando(-1, 2),
-                                rando(1, 5),
-                                col,
-                                rando(0, 1) > 0.5};
-  }
-
-  *realObjCount = desiredObjCount; // overwrite, all other object data will be ignored
+#if !HEADLESS
+// The frame rate, its running average and the tick count in the corner, and the time of each phase of the tick
+// beside them.
+static void drawHUD(float framerate, float framerateAverage, int frame, const uint64_t phases[]) {
+  char framerateDisplay[11];
+  char frameAvgDisplay[10];
+  char frameCounterDisplay[20];
+
+  // Calculate and draw the FPS count to the screen.
+  sprintf(framerateDisplay, "FPS: %.2f", framerate);
+  framerateDisplay[10] = '\0';
+
+  sprintf(frameCounterDisplay, "%d", frame);
+  frameCounterDisplay[sizeof(frameCounterDisplay) / sizeof(frameCounterDisplay[0]) - 1] = '\0';
+
+  sprintf(frameAvgDisplay, "%f", framerateAverage);
+  frameAvgDisplay[sizeof(frameAvgDisplay) / sizeof(frameAvgDisplay[0]) - 1] = '\0';
+
+  DrawText(framerateDisplay, 5, 5, 20, WHITE);
+  DrawText(frameAvgDisplay, 5, 30, 20, WHITE);
+  DrawText(frameCounterDisplay, 120, 5, 20, WHITE);
+
+  for (size_t p = 0; PHASE_TIMING && p < PHASE_COUNT; p++) {
+    char phaseDisplay[48];
+    snprintf(phaseDisplay, sizeof(phaseDisplay), "%-10s %7.3f ms", PHASE_NAMES[p], phases[p] / 1e6);
+    DrawText(phaseDisplay, 200, 5 + 16 * p, 15, WHITE);
+  }
 }
 
-static void configureSAT(SAT_Object *SATs[], size_t *realObjCount, size_t desiredObjCount) {
-  Color col = (Color){0, 0, 0, 255};
+// A run with --decouple: the simulation ticks on its own thread at the fixed rate of options->dt, and the window
+// draws the latest snapshot of it at its own rate, so neither times the other's work.
+typedef struct {
+  const Options *options;
+  void *scene;
+  Broadphase *broadphase;
+  Narrowphase *narrowphase;
+  // The counters and the data file are opened on the simulation thread, counters only count the thread that opened
+  // them and the data lists the counters that thread has.
+  uint64_t seed;
+  Recorder *recorder;
+  bool keepOpen;
+  Snapshots snapshots;
+  pthread_mutex_t lock;
+  // ---------- Under the lock. ----------
+  // Set by the render thread.
+  bool paused;
+  bool tickOnce;
+  bool stopping;
+  float framerate;
+  // Set by the simulation thread once it is done.
+  bool finished;
+  // ---------- Only read once the simulation thread is joined. ----------
+  int frameCounter;
+  // Tick time since the worker statistics were reset.
+  uint64_t workerTime;
+} Simulation;
+
+static void *simulate(void *argument) {
+  Simulation *simulation = (Simulation *)argument;
+  const Options *options = simulation->options;
+  const Engine *engine = options->engine;
+  Recorder *recorder = simulation->recorder;
+  Counters counters = {.leader = -1};
+  long period = (long)(options->dt * 1e9);
+  struct timespec next;
+  int frame = 0;
+
+  if (options->counters) {
+    Counters_open(&counters);
+  }
+
+  unsigned mask = Counters_mask(&counters);
+  recorder->recording =
+      options->recording && openData(&recorder->data, options, recorder->run, simulation->seed, mask);
+
+  clock_gettime(CLOCK_MONOTONIC, &next);
+
+  while (simulation->keepOpen || frame < recorder->lastFrame) {
+    pthread_mutex_lock(&simulation->lock);
+    bool stopping = simulation->stopping;
+    bool step = !simulation->paused || simulation->tickOnce;
+    float framerate = simulation->framerate;
+    simulation->tickOnce = false;
+    pthread_mutex_unlock(&simulation->lock);
+
+    if (stopping) {
+      break;
+    }
+
+    if (frame == 1) {
+      recorder->startTime = Timer_nanoseconds();
 
-  for (size_t i = 0; i < desiredObjCount; i++) {
-    col.r = (int)rando(100, 230);
-    col.g = (int)rando(100, 230);
-    col.b = (int)rando(100, 230);
-    Vector2 *vertices = (Vector2 *)calloc(8, sizeof(Vector2));
-    int verticesCount = (int)rando(3, 8);
+      if (simulation->narrowphase) {
+        Workers_resetStats(&simulation->narrowphase->workers);
+        simulation->workerTime = 0;
+      }
+    }
 
-    // This magic number is connected to the size of the object, with increasing object count, the objects should be
-    // smaller. To ensure that the objects are never negative in size or zero, it has an asymptote at x=0. Furthermore,
-    // we wish the "magicNumber" aka radius to be 1 at its maximum (zero objects) and decreasing. Source: pulled it out
-    // of my ass - Abigail
-    float magicNumber = 1 * (1.0 / pow(1.005, desiredObjCount));
-    magicNumber *= rando(0.7, 1.3);
+    size_t allocationsBefore = allocations();
+    CounterReading countersBefore;
+    Counters_read(&counters, &countersBefore);
+    Phase_reset();
+    uint64_t tickStart = Timer_nanoseconds();
 
-    double angIncrement = 2 * PI / (double)verticesCount;
-    for (int i = 0; i < verticesCount; i++) {
-      double angle = angIncrement * i;
+    if (step) {
+      engine->step(simulation->scene, options->dt, simulation->broadphase, simulation->narrowphase);
+    }
 
-      vertices[i] = (Vector2){magicNumber * cos(angle), magicNumber * sin(angle)};
+    uint64_t tick = Timer_nanoseconds() - tickStart;
+    simulation->workerTime += tick;
+    CounterReading countersAfter;
+    uint64_t tickCounts[COUNTER_COUNT];
+    Counters_read(&counters, &countersAfter);
+    Counters_difference(&countersBefore, &countersAfter, tickCounts);
+    size_t tickAllocations = allocations() - allocationsBefore;
+    frame++;
+
+    Snapshot *snapshot = Snapshots_back(&simulation->snapshots);
+    engine->positions(simulation->scene, snapshot->positions);
+    snapshot->tick = (uint64_t)frame;
+    snapshot->tickTime = tick;
+
+    for (size_t p = 0; p < PHASE_COUNT; p++) {
+      snapshot->phases[p] = Phase_nanoseconds(p);
     }
 
-    (*SATs)[i] = (SAT_Object){vertices,
-                              verticesCount,
-                              (Vector2){rando(1 + magicNumber, 5), rando(1 + magicNumber, 5)},
-                              (Vector2){rando(-1, 2), rando(-1, 2)},
-                              col,
-                              rando(1, 5)};
+    Snapshots_publish(&simulation->snapshots);
+    // The frame rate is the window's, the tick time the simulation's own.
+    recordTick(recorder, frame, tick, framerate, tickAllocations, tickCounts);
+
+    // Keep to the fixed rate. A tick that ends late is followed right away, without catching up on the ones missed.
+    struct timespec now;
+    next.tv_nsec += period;
+    next.tv_sec += next.tv_nsec / 1000000000L;
+    next.tv_nsec %= 1000000000L;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    if (now.tv_sec > next.tv_sec || (now.tv_sec == next.tv_sec && now.tv_nsec >= next.tv_nsec)) {
+      next = now;
+    } else {
+      clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+    }
   }
 
-  *realObjCount = desiredObjCount; // overwrite, all other object data will be ignored
+  Counters_close(&counters);
+  simulation->frameCounter = frame;
+
+  pthread_mutex_lock(&simulation->lock);
+  simulation->finished = true;
+  pthread_mutex_unlock(&simulation->lock);
+  return NULL;
 }
 
-int main() {
-  srand(time(NULL));
+// Start the simulation thread and draw its latest snapshot every frame until it finishes, or until the window is
+// closed. Returns false if the window was closed.
+static bool drawSimulation(Simulation *simulation) {
+  pthread_t thread;
+  bool windowOpen = true;
+  float framerateAverage = 0;
+  double frTot = 0;
+  int frames = 0;
+
+  if (pthread_create(&thread, NULL, simulate, simulation) != 0) {
+    fprintf(stderr, "Failed to start the simulation thread.\n");
+    return true;
+  }
 
-  InitWindow(VIRTUAL_WIDTH, VIRTUAL_HEIGHT, "Collision Algorithm Benchmark");
-  SetTargetFPS(FRAMERATE);
+  while (true) {
+    if (WindowShouldClose()) {
+      windowOpen = false;
+      break;
+    }
+
+    int key = GetKeyPressed();
+    float framerate = 1 / GetFrameTime();
+
+    if (key == KEY_P) {
+      printf("pausing\n");
+      fflush(stdout);
+    }
+
+    if (key == KEY_T) {
+      printf("ticking\n");
+      fflush(stdout);
+    }
+
+    pthread_mutex_lock(&simulation->lock);
+    simulation->paused = simulation->paused != (key == KEY_P);
+    simulation->tickOnce = simulation->tickOnce || key == KEY_T;
+    simulation->framerate = framerate;
+    bool finished = simulation->finished;
+    pthread_mutex_unlock(&simulation->lock);
+
+    if (finished) {
+      break;
+    }
+
+    const Snapshot *snapshot = Snapshots_latest(&simulation->snapshots);
+
+    BeginDrawing();
+    ClearBackground((Color){20, 20, 20, 255});
+    simulation->options->engine->draw(simulation->scene, snapshot->positions);
+
+    frTot += framerate / (float)FRAMES_PER_AVERAGE;
+
+    if (++frames % FRAMES_PER_AVERAGE == 0) {
+      framerateAverage = frTot;
+      frTot = 0;
+    }
+
+    drawHUD(framerate, framerateAverage, (int)snapshot->tick, snapshot->phases);
+    EndDrawing();
+  }
+
+  pthread_mutex_lock(&simulation->lock);
+  simulation->stopping = true;
+  pthread_mutex_unlock(&simulation->lock);
+  pthread_join(thread, NULL);
+  return windowOpen;
+}
+#endif
+
+// Simulate one run on the scene generated from seed and record it. If ticks is not NULL, it gets the time of every
+// recorded tick. Open counters are read around every tick. Without keepOpen, the run ends once its frames are
+// recorded. Returns false if the window was closed.
+static bool runBenchmark(const Options *options, int run, uint64_t seed, bool keepOpen, double ticks[],
+                         const Counters *counters, Narrowphase *narrowphase) {
 
   float dt = 0;
   float trueFramerate = 0;
-  float framerateAverage = 0;
-  double frTot = 0;
   int frameCounter = 0;
+  bool windowOpen = true;
+  // Only a window has anything to decouple the simulation from.
+  bool decoupled = !HEADLESS && options->decouple;
 
-  char framerateDisplay[11];
-  char frameAvgDisplay[10];
-  char frameCounterDisplay[20];
+#if !HEADLESS
+  float framerateAverage = 0;
+  double frTot = 0;
+  Vector2 *positions = NULL;
+#endif
 
-  AABB_Object *simpleAABBObjects = (AABB_Object *)calloc(MAXOBJECTS, sizeof(AABB_Object));
-  size_t AABBSize = 0;
+  const Engine *engine = options->engine;
+  SceneObject *objects = (SceneObject *)calloc(options->objects, sizeof(SceneObject));
+  void *scene = NULL;
 
-  if (!IS_SIMULATING_SAT) {
-    configureAABB(&simpleAABBObjects, &AABBSize, DESIREDOBJECTS);
+  if (objects) {
+    Scene_generate(objects, options->objects, seed);
+    scene = engine->create(objects, options->objects);
+    free(objects);
   }
 
-  SAT_Object *SATObjects = (SAT_Object *)calloc(MAXOBJECTS, sizeof(SAT_Object));
-  size_t SATsize = 0;
+#if !HEADLESS
+  // The positions the window draws, taken from the scene after every tick or handed over in snapshots.
+  positions = scene ? (Vector2 *)calloc(options->objects, sizeof(Vector2)) : NULL;
 
-  if (IS_SIMULATING_SAT) {
-    configureSAT(&SATObjects, &SATsize, DESIREDOBJECTS);
+  if (scene && !positions) {
+    engine->destroy(scene);
+    scene = NULL;
   }
+#endif
+
+  if (!scene) {
+    fprintf(stderr, "Failed to create a %s scene of %zu objects.\n", engine->name, options->objects);
+    return false;
+  }
+
+  Broadphase broadphase = Broadphase_create(options->broadphase);
 
   // game loop
   bool paused = false;
   bool onetickonly = false;
 
-  JSONDataPoint *JSONDataPoints = (JSONDataPoint *)calloc(MAXOBJECTS, sizeof(JSONDataPoint));
-  clock_t startTime;
+  Recorder recorder = {.run = run, .lastFrame = options->frames + 2, .ticks = ticks};
+  recorder.recording =
+      !decoupled && options->recording && openData(&recorder.data, options, run, seed, Counters_mask(counters));
+  recorder.startTime = Timer_nanoseconds();
+  // Tick time since the worker statistics were reset.
+  uint64_t workerTime = 0;
+
+#if !HEADLESS
+  if (decoupled) {
+    Simulation simulation = {.options = options,
+                             .scene = scene,
+                             .broadphase = &broadphase,
+                             .narrowphase = narrowphase,
+                             .seed = seed,
+                             .recorder = &recorder,
+                             .keepOpen = keepOpen};
+    engine->positions(scene, positions);
+
+    if (Snapshots_create(&simulation.snapshots, options->objects, positions)) {
+      pthread_mutex_init(&simulation.lock, NULL);
+      windowOpen = drawSimulation(&simulation);
+      pthread_mutex_destroy(&simulation.lock);
+      Snapshots_free(&simulation.snapshots);
+      frameCounter = simulation.frameCounter;
+      workerTime = simulation.workerTime;
+    } else {
+      fprintf(stderr, "Failed to allocate the snapshots of %zu objects.\n", options->objects);
+    }
+  }
+#endif
+
+  while (!decoupled && (keepOpen || frameCounter < recorder.lastFrame)) {
+#if !HEADLESS
+    if (WindowShouldClose()) {
+      windowOpen = false;
+      break;
+    }
+#endif
 
-  while (!WindowShouldClose()) {
     if (frameCounter == 1) {
-      startTime = clock();
+      recorder.startTime = Timer_nanoseconds();
+
+      if (narrowphase) {
+        Workers_resetStats(&narrowphase->workers);
+        workerTime = 0;
+      }
     }
 
+#if HEADLESS
+    // Every tick advances the world by the same step, so runs on different machines simulate the same thing.
+    dt = options->dt;
+#else
     // Get user input.
     int key = GetKeyPressed();
 
@@ -181,55 +478,47 @@ int main() {
       onetickonly = true;
     }
 
-    // Update the time since the last frame/tick.
-    dt = GetFrameTime();
-    trueFramerate = 1 / dt;
+    // Update the time since the last frame/tick, unless the step is fixed.
+    dt = options->dt > 0 ? options->dt : GetFrameTime();
+#endif
+
+    size_t allocationsBefore = allocations();
+    CounterReading countersBefore;
+    Counters_read(counters, &countersBefore);
+    Phase_reset();
+    uint64_t tickStart = Timer_nanoseconds();
 
     if (onetickonly) {
-      IS_SIMULATING_SAT ? SAT_simulate(SATObjects, SATsize, dt) : AABB_simulate(simpleAABBObjects, AABBSize, dt);
+      engine->step(scene, dt, &broadphase, narrowphase);
       onetickonly = false;
     }
 
     // Simulate.
     if (!paused && !onetickonly) {
-      IS_SIMULATING_SAT ? SAT_simulate(SATObjects, SATsize, dt) : AABB_simulate(simpleAABBObjects, AABBSize, dt);
+      engine->step(scene, dt, &broadphase, narrowphase);
     }
 
+    uint64_t tick = Timer_nanoseconds() - tickStart;
+    workerTime += tick;
+    CounterReading countersAfter;
+    uint64_t tickCounts[COUNTER_COUNT];
+    Counters_read(counters, &countersAfter);
+    Counters_difference(&countersBefore, &countersAfter, tickCounts);
+    size_t frameAllocations = allocations() - allocationsBefore;
+
+#if HEADLESS
+    // Without frame pacing, the rate is how many ticks the simulation alone manages per second.
+    trueFramerate = 1e9 / (tick > 0 ? tick : 1);
+    frameCounter++;
+#else
+    trueFramerate = 1 / GetFrameTime();
+
     // Draw.
     BeginDrawing();
     ClearBackground((Color){20, 20, 20, 255});
 
-    if (!IS_SIMULATING_SAT) {
-      for (size_t i = 0; i < AABBSize; i++) {
-        drawAABB(simpleAABBObjects[i], i);
-      }
-    } else {
-      for (size_t i = 0; i < SATsize; i++) {
-        drawSAT(SATObjects[i]);
-        SAT_Object A = SATObjects[0];
-        // int vert = SAT_findSide(SATObjects[0], SATObjects[1]);
-        // Vector2 res = vectorMiddle(Vector2Add(A.vertices[vert], A.position),
-        //                            Vector2Add(A.vertices[(vert + 1) % A.vertices_count], A.position));
-        // DrawCircle(res.x * SCALE, res.y * SCALE, 3, RED);
-        // Vector2 vec = SAT_findOptimalNormal(SATObjects[0], SATObjects[1]);
-        // DrawCircle((res.x + vec.x) * SCALE, (res.y + vec.y) * SCALE, 3, RED);
-        // double viilength = SAT_project(A.velocity, vec);
-        // Vector2 vii = Vector2Scale(vec, viilength / Vector2Length(vec));
-        // Vector2 vperpen = SAT_perpendicular(vii, A.velocity);
-        // DrawCircle((res.x + vii.x) * SCALE, (res.y + vii.y) * SCALE, 3, BLUE);
-        // DrawCircle((res.x + vperpen.x) * SCALE, (res.y + vperpen.y) * SCALE, 3, GREEN);
-      }
-    }
-
-    // Calculate and draw the FPS count to the screen.
-    sprintf(framerateDisplay, "FPS: %.2f", trueFramerate);
-    framerateDisplay[10] = '\0';
-
-    sprintf(frameCounterDisplay, "%d", frameCounter);
-    frameCounterDisplay[sizeof(frameCounterDisplay) / sizeof(frameCounterDisplay[0]) - 1] = '\0';
-
-    sprintf(frameAvgDisplay, "%f", framerateAverage);
-    frameAvgDisplay[sizeof(frameAvgDisplay) / sizeof(frameAvgDisplay[0]) - 1] = '\0';
+    engine->positions(scene, positions);
+    engine->draw(scene, positions);
 
     frTot += trueFramerate / (float)FRAMES_PER_AVERAGE;
     frameCounter++;
@@ -239,31 +528,214 @@ int main() {
       frTot = 0;
     }
 
-    DrawText(framerateDisplay, 5, 5, 20, WHITE);
-    DrawText(frameAvgDisplay, 5, 30, 20, WHITE);
-    DrawText(frameCounterDisplay, 120, 5, 20, WHITE);
+    // The time of each phase of this frame's tick, beside the FPS.
+    uint64_t phases[PHASE_COUNT];
+
+    for (size_t p = 0; p < PHASE_COUNT; p++) {
+      phases[p] = Phase_nanoseconds(p);
+    }
+
+    drawHUD(trueFramerate, framerateAverage, frameCounter, phases);
     EndDrawing();
+#endif
+
+    recordTick(&recorder, frameCounter, tick, trueFramerate, frameAllocations, tickCounts);
+  }
+
+  // A closed window ends the run early, keep what was recorded.
+  if (recorder.recording) {
+    closeData(&recorder.data);
+  }
+
+  if (frameCounter >= recorder.lastFrame) {
+    printf("%s %s run %d (seed %" PRIu64 "): %zu objects, %.3f ms physics per tick over %d ticks\n", engine->name,
+           broadphaseName(options->broadphase), run, seed, options->objects,
+           recorder.tickTotal / 1e6 / options->frames, options->frames);
+
+    if (narrowphase && narrowphase->workers.count > 1) {
+      printUtilization(&narrowphase->workers, workerTime);
+    }
+  }
+
+  // Free the allocated memory by the stress-test objects.
+  engine->destroy(scene);
+  Broadphase_free(&broadphase);
+#if !HEADLESS
+  free(positions);
+#endif
+  return windowOpen;
+}
+
+// Time each engine over a geometric series of object counts, options.runs runs per count, and write the statistics
+// of every count to one file. Returns false if the window was closed before the sweep finished.
+static bool runSweep(Options options, const Counters *counters, Narrowphase *narrowphase) {
+  size_t pointCapacity = 1;
+
+  for (double n = options.sweepFrom; n * options.sweepFactor <= options.sweepTo; n *= options.sweepFactor) {
+    pointCapacity++;
+  }
+
+  size_t sampleCount = (size_t)options.runs * options.frames;
+  double *ticks = (double *)calloc(sampleCount, sizeof(double));
+  SweepSeries series[ENGINE_COUNT] = {0};
+  size_t seriesCount = 0;
+  bool windowOpen = ticks != NULL;
+
+  for (size_t e = 0; e < ENGINE_COUNT && windowOpen; e++) {
+    if (options.algorithmGiven && options.engine != ENGINES[e]) {
+      continue;
+    }
+
+    Options point = options;
+    point.engine = ENGINES[e];
+    point.recording = false;
+
+    if (!options.broadphaseGiven) {
+      point.broadphase = ENGINES[e]->defaultBroadphase;
+    }
+
+    SweepSeries *current = &series[seriesCount++];
+    *current = (SweepSeries){.algorithm = point.engine->name, .broadphase = broadphaseName(point.broadphase)};
+    current->points = (SweepPoint *)calloc(pointCapacity, sizeof(SweepPoint));
+
+    if (!current->points) {
+      windowOpen = false;
+      break;
+    }
+
+    // Round every count of the series, and make sure it grows even when the factor is close to 1.
+    for (double n = options.sweepFrom; n <= options.sweepTo && windowOpen; n *= options.sweepFactor) {
+      size_t count = (size_t)round(n);
+
+      if (current->pointCount > 0 && count <= current->points[current->pointCount - 1].objectCount) {
+        continue;
+      }
 
-    if (frameCounter > 1 && frameCounter < 502 && IS_RECORDING_DATA) {
-      JSONDataPoints[frameCounter - 2].time = clock() - startTime;
-      JSONDataPoints[frameCounter - 2].fps = trueFramerate;
+      point.objects = count;
+
+      for (int r = 0; r < options.runs && windowOpen; r++) {
+        windowOpen = runBenchmark(&point, options.firstRun + r, options.seed, false, ticks + r * options.frames,
+                                  counters, narrowphase);
+      }
+
+      if (windowOpen) {
+        SweepPoint *result = &current->points[current->pointCount++];
+        *result = (SweepPoint){count, tickStats(ticks, sampleCount)};
+        printf("%s %s: %zu objects, mean %.3f ms, median %.3f ms, p95 %.3f ms, p99 %.3f ms, stddev %.3f ms\n",
+               current->algorithm, current->broadphase, count, result->ticks.mean * 1e3, result->ticks.median * 1e3,
+               result->ticks.p95 * 1e3, result->ticks.p99 * 1e3, result->ticks.stddev * 1e3);
+      }
     }
 
-    if (frameCounter == 502 && IS_RECORDING_DATA) {
-      JSONData data = (JSONData){DESIREDOBJECTS, JSONDataPoints};
-      char *json = dataToJSON(data, frameCounter - 2);
-      sprintf(TEXTDEBUGTMP, "./data/%s_run_%d.json", (IS_SIMULATING_SAT) ? "SAT" : "AABB", RUN_NUMBER);
-      FILE *dataFile = fopen(TEXTDEBUGTMP, "w");
-      fprintf(dataFile, json);
+    current->exponent = fitExponent(current->points, current->pointCount);
+    printf("%s %s: tick time grows as N^%.2f\n", current->algorithm, current->broadphase, current->exponent);
+  }
+
+  char *json = options.recording ? sweepToJSON(series, seriesCount, options.runs, options.frames) : NULL;
 
+  if (json) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/sweep%s.json", options.output, HEADLESS ? "_headless" : "");
+    FILE *dataFile = fopen(path, "w");
+
+    if (dataFile) {
+      fputs(json, dataFile);
       fclose(dataFile);
-      free(json);
+    } else {
+      fprintf(stderr, "Failed to open %s.\n", path);
     }
+
+    free(json);
   }
 
-  // Free the allocated memory by the stress-test objects.
-  free(simpleAABBObjects);
-  free(SATObjects);
+  for (size_t s = 0; s < seriesCount; s++) {
+    free(series[s].points);
+  }
+
+  free(ticks);
+  return windowOpen;
+}
+
+int main(int argc, char **argv) {
+  Options options;
+
+  if (!Options_parse(argc, argv, &options)) {
+    return 1;
+  }
+
+  if (options.tsc) {
+    if (Timer_useTSC(50)) {
+      printf("Timing with the TSC at %.3f GHz.\n", Timer_TSCGigahertz());
+    } else {
+      fprintf(stderr, "No invariant TSC, timing with the monotonic clock.\n");
+    }
+  }
+
+  // Counters that cannot be opened are only left out of the data.
+  Counters counters = {.leader = -1};
+
+  if (options.counters && Counters_open(&counters)) {
+    printf("Counting");
+    for (size_t i = 0; i < counters.opened; i++) {
+      printf(" %s", COUNTER_NAMES[counters.order[i]]);
+    }
+    printf(".\n");
+  } else if (options.counters) {
+    fprintf(stderr, "No hardware performance counters available, recording timings only.\n");
+  }
+
+  // Without threads the simulation keeps to the calling thread, and tests and responds to pairs in one serial loop.
+  // That is a different simulation from the staged one of any number of threads.
+  Narrowphase threads = {0};
+  Narrowphase *narrowphase = NULL;
+
+  if (options.threads > 0 && Narrowphase_create(&threads, options.threads)) {
+    narrowphase = &threads;
+    printf("Simulating on %zu thread%s.\n", options.threads, options.threads == 1 ? "" : "s");
+  } else if (options.threads > 0) {
+    fprintf(stderr, "Failed to start %zu threads, simulating serially.\n", options.threads);
+  }
+
+  if (narrowphase && narrowphase->workers.count > 1 && counters.opened > 0) {
+    fprintf(stderr, "The counters only count the simulating thread, not the other %zu workers.\n",
+            narrowphase->workers.count - 1);
+  }
+
+  // A decoupled simulation opens its own counters on its thread, these were only opened to see which are available.
+  if (!HEADLESS && options.decouple) {
+    Counters_close(&counters);
+  }
+
+  // Without a window, or with the simulation on its own thread, every tick advances the world by the same step.
+  if (options.dt == 0 && (HEADLESS || options.decouple)) {
+    options.dt = 1.0F / options.framerate;
+  }
+
+#if !HEADLESS
+  InitWindow(VIRTUAL_WIDTH, VIRTUAL_HEIGHT, "Collision Algorithm Benchmark");
+  SetTargetFPS(options.framerate);
+#endif
+
+  if (options.sweep) {
+    runSweep(options, &counters, narrowphase);
+  }
+
+  for (int r = 0; r < options.runs && !options.sweep; r++) {
+    // The last run stays on screen until the window is closed.
+    bool keepOpen = !HEADLESS && r == options.runs - 1;
+
+    if (!runBenchmark(&options, options.firstRun + r, options.seed, keepOpen, NULL, &counters, narrowphase)) {
+      break;
+    }
+  }
+
+  if (narrowphase) {
+    Narrowphase_free(narrowphase);
+  }
+
+  Counters_close(&counters);
+#if !HEADLESS
   CloseWindow();
+#endif
   return 0;
 }
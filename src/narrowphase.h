@@ -0,0 +1,271 @@
+// Parallel narrowphase: the workers test the candidate pairs against the state at the start of the stage and collect
+// the colliding ones, for the simulation to resolve afterwards.
+// The objects are cut into chunks of consecutive objects with about as many pair tests each, and every chunk keeps
+// its contacts in its own list. Whichever worker tests a chunk, reading the lists chunk by chunk gives the contacts
+// in the same order for any number of threads, and so the same results.
+// The contacts can then be split into batches in which no two contacts share an object, and each batch resolved on
+// the workers. Every object still sees its contacts in the order of the lists, so the results stay the same.
+
+#include <broadphase.h>
+#include <common.h>
+#include <math.h>
+#include <utils.h>
+#include <workers.h>
+
+#pragma once
+
+// Enough chunks per worker for the scheduler to even out the cost of the pair tests by stealing.
+#define NARROWPHASE_CHUNKS_PER_WORKER 8
+// A batch is cut into about this many chunks per worker, so every worker gets a share even of the ~100 contacts a
+// batch of a settled scene holds, and stealing can still even them out.
+#define NARROWPHASE_RESOLVE_CHUNKS_PER_WORKER 2
+// But never fewer contacts than this per chunk, below it waking the workers costs more than they save. A batch of one
+// chunk is resolved on the calling thread.
+#define NARROWPHASE_RESOLVE_MIN_GRAIN 8
+
+typedef struct {
+  CandidatePair *pairs;
+  size_t count;
+  size_t capacity;
+  // Set if a contact could not be stored.
+  bool failed;
+} ContactList;
+
+typedef struct {
+  Workers workers;
+  size_t chunkCount;
+  // One list per chunk.
+  ContactList *contacts;
+  // Chunk c holds the objects rangeStart[c]..rangeStart[c + 1].
+  size_t *rangeStart;
+  // ---------- Batches of contacts that share no object. ----------
+  // The first batch the next contact of each object can go in.
+  size_t *nextBatch;
+  size_t nextBatchCapacity;
+  size_t *contactBatch;
+  size_t contactBatchCapacity;
+  // The contacts of batch b are batched[batchStart[b]..batchStart[b + 1]), in the order of the lists.
+  CandidatePair *batched;
+  size_t batchedCapacity;
+  size_t *batchStart;
+  size_t batchStartCapacity;
+  size_t batchCount;
+  // Objects whose remaining contacts are skipped, for engines that end an object's contacts early. Cleared by
+  // Narrowphase_batch.
+  bool *ended;
+  size_t endedCapacity;
+} Narrowphase;
+
+void Narrowphase_free(Narrowphase *narrowphase) {
+  for (size_t c = 0; narrowphase->contacts && c < narrowphase->chunkCount; c++) {
+    free(narrowphase->contacts[c].pairs);
+  }
+
+  free(narrowphase->contacts);
+  free(narrowphase->rangeStart);
+  free(narrowphase->nextBatch);
+  free(narrowphase->contactBatch);
+  free(narrowphase->batched);
+  free(narrowphase->batchStart);
+  free(narrowphase->ended);
+  Workers_stop(&narrowphase->workers);
+}
+
+// Start threads workers in place. Returns false if they or their lists could not be allocated.
+bool Narrowphase_create(Narrowphase *narrowphase, size_t threads) {
+  *narrowphase = (Narrowphase){0};
+
+  if (!Workers_start(&narrowphase->workers, threads)) {
+    return false;
+  }
+
+  size_t chunks = narrowphase->workers.count * NARROWPHASE_CHUNKS_PER_WORKER;
+  narrowphase->contacts = (ContactList *)calloc(chunks, sizeof(ContactList));
+  narrowphase->rangeStart = (size_t *)calloc(chunks + 1, sizeof(size_t));
+  narrowphase->chunkCount = narrowphase->contacts ? chunks : 0;
+
+  if (!narrowphase->contacts || !narrowphase->rangeStart) {
+    Narrowphase_free(narrowphase);
+    return false;
+  }
+
+  return true;
+}
+
+// Split count objects into chunks with about as many pair tests each: the candidate pairs when the broadphase found
+// them, otherwise every later object, which is fewer the later the object.
+void Narrowphase_partition(Narrowphase *narrowphase, size_t count, const Broadphase *broadphase, bool useBroadphase) {
+  size_t chunks = narrowphase->chunkCount;
+  size_t *start = narrowphase->rangeStart;
+
+  for (size_t c = 0; c <= chunks; c++) {
+    double share = (double)c / chunks;
+
+    if (useBroadphase) {
+      // The first object whose pairs start at or after this chunk's share of them.
+      size_t target = (size_t)(share * broadphase->pairCount);
+      size_t low = c ? start[c - 1] : 0;
+      size_t high = count;
+
+      while (low < high) {
+        size_t middle = low + (high - low) / 2;
+
+        if (broadphase->pairStart[middle] < target) {
+          low = middle + 1;
+        } else {
+          high = middle;
+        }
+      }
+
+      start[c] = low;
+    } else {
+      // The objects before i test about count^2 - (count - i)^2 pairs.
+      start[c] = (size_t)(count * (1 - sqrt(1 - share)));
+    }
+  }
+
+  start[chunks] = count;
+}
+
+// Store a contact in a chunk's list. Returns false if it could not be stored.
+static inline bool Narrowphase_add(ContactList *list, size_t a, size_t b) {
+  if (!reserveArray((void **)&list->pairs, &list->capacity, list->count + 1, sizeof(CandidatePair))) {
+    list->failed = true;
+    return false;
+  }
+
+  list->pairs[list->count++] = (CandidatePair){a, b};
+  return true;
+}
+
+// Empty the lists and run job over the chunks on the workers. Returns false if any contact could not be stored.
+bool Narrowphase_run(Narrowphase *narrowphase, RangeJob job, void *context) {
+  for (size_t c = 0; c < narrowphase->chunkCount; c++) {
+    narrowphase->contacts[c].count = 0;
+    narrowphase->contacts[c].failed = false;
+  }
+
+  Workers_parallelFor(&narrowphase->workers, narrowphase->chunkCount, 1, job, context);
+
+  for (size_t c = 0; c < narrowphase->chunkCount; c++) {
+    if (narrowphase->contacts[c].failed) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Put every contact in the batch after the last one holding a contact of either of its objects, then group them by
+// batch. No two contacts of a batch share an object, and each object's contacts keep their order.
+// Returns false if an allocation failed.
+bool Narrowphase_batch(Narrowphase *narrowphase, size_t count) {
+  size_t total = 0;
+
+  for (size_t l = 0; l < narrowphase->chunkCount; l++) {
+    total += narrowphase->contacts[l].count;
+  }
+
+  if (!reserveArray((void **)&narrowphase->nextBatch, &narrowphase->nextBatchCapacity, count, sizeof(size_t)) ||
+      !reserveArray((void **)&narrowphase->ended, &narrowphase->endedCapacity, count, sizeof(bool)) ||
+      !reserveArray((void **)&narrowphase->contactBatch, &narrowphase->contactBatchCapacity, total, sizeof(size_t)) ||
+      !reserveArray((void **)&narrowphase->batched, &narrowphase->batchedCapacity, total, sizeof(CandidatePair))) {
+    return false;
+  }
+
+  size_t *nextBatch = narrowphase->nextBatch;
+  size_t batchCount = 0;
+  size_t c = 0;
+
+  for (size_t i = 0; i < count; i++) {
+    nextBatch[i] = 0;
+    narrowphase->ended[i] = false;
+  }
+
+  for (size_t k = 0; k < narrowphase->chunkCount; k++) {
+    const ContactList *list = &narrowphase->contacts[k];
+
+    for (size_t l = 0; l < list->count; l++, c++) {
+      CandidatePair contact = list->pairs[l];
+      size_t batch = nextBatch[contact.a] > nextBatch[contact.b] ? nextBatch[contact.a] : nextBatch[contact.b];
+
+      narrowphase->contactBatch[c] = batch;
+      nextBatch[contact.a] = nextBatch[contact.b] = batch + 1;
+      batchCount = batch + 1 > batchCount ? batch + 1 : batchCount;
+    }
+  }
+
+  if (!reserveArray((void **)&narrowphase->batchStart, &narrowphase->batchStartCapacity, batchCount + 1,
+                    sizeof(size_t))) {
+    return false;
+  }
+
+  // Counting sort by batch, as Broadphase_groupPairs groups the pairs by object.
+  size_t *start = narrowphase->batchStart;
+
+  for (size_t b = 0; b <= batchCount; b++) {
+    start[b] = 0;
+  }
+
+  for (c = 0; c < total; c++) {
+    start[narrowphase->contactBatch[c] + 1]++;
+  }
+
+  for (size_t b = 0; b < batchCount; b++) {
+    start[b + 1] += start[b];
+  }
+
+  c = 0;
+
+  for (size_t k = 0; k < narrowphase->chunkCount; k++) {
+    const ContactList *list = &narrowphase->contacts[k];
+
+    for (size_t l = 0; l < list->count; l++, c++) {
+      narrowphase->batched[start[narrowphase->contactBatch[c]]++] = list->pairs[l];
+    }
+  }
+
+  // Placing the contacts shifted every offset one batch forward, shift them back.
+  for (size_t b = batchCount; b > 0; b--) {
+    start[b] = start[b - 1];
+  }
+  start[0] = 0;
+
+  narrowphase->batchCount = batchCount;
+  return true;
+}
+
+// Resolve one contact. Only the two objects of the contact may be touched.
+typedef void (*ContactResolver)(void *context, CandidatePair contact);
+
+typedef struct {
+  const CandidatePair *contacts;
+  ContactResolver resolve;
+  void *context;
+} BatchJob;
+
+static void Narrowphase_resolveRange(void *context, size_t begin, size_t end) {
+  BatchJob *job = (BatchJob *)context;
+
+  for (size_t c = begin; c < end; c++) {
+    job->resolve(job->context, job->contacts[c]);
+  }
+}
+
+// Resolve the batches of Narrowphase_batch one after another, each on the workers.
+void Narrowphase_resolve(Narrowphase *narrowphase, ContactResolver resolve, void *context) {
+  size_t chunks = narrowphase->workers.count * NARROWPHASE_RESOLVE_CHUNKS_PER_WORKER;
+
+  for (size_t b = 0; b < narrowphase->batchCount; b++) {
+    size_t first = narrowphase->batchStart[b];
+    size_t size = narrowphase->batchStart[b + 1] - first;
+    size_t grain = (size + chunks - 1) / chunks;
+    BatchJob job = {narrowphase->batched + first, resolve, context};
+
+    if (grain < NARROWPHASE_RESOLVE_MIN_GRAIN) {
+      grain = NARROWPHASE_RESOLVE_MIN_GRAIN;
+    }
+
+    Workers_parallelFor(&narrowphase->workers, size, grain, Narrowphase_resolveRange, &job);
+  }
+}
@@ -0,0 +1,243 @@
+// Command-line options, so one binary can run every point of a sweep without being rebuilt.
+
+#include <broadphase.h>
+#include <engines.h>
+#include <errno.h>
+#include <float.h>
+#include <getopt.h>
+#include <limits.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#pragma once
+
+typedef struct {
+  const Engine *engine;
+  BroadphaseMode broadphase;
+  // A sweep runs every engine, with their default broadphases, unless these were chosen.
+  bool algorithmGiven;
+  bool broadphaseGiven;
+  size_t objects;
+  // Runs are numbered from firstRun in the file names. Every run simulates the scene generated from seed.
+  int firstRun;
+  int runs;
+  // Frames recorded per run, after two warm-up frames.
+  int frames;
+  uint64_t seed;
+  // Fixed time step in seconds. 0 uses the time the last frame took, or 1 / framerate without a window.
+  float dt;
+  int framerate;
+  bool recording;
+  // Record binary traces instead of JSON, see tools/trace_convert.c.
+  bool trace;
+  // Time with the calibrated time-stamp counter instead of the monotonic clock.
+  bool tsc;
+  // Record hardware performance counters around each tick.
+  bool counters;
+  // Run the simulation's passes on this many threads, testing every pair before responding to any. 0 keeps to the
+  // calling thread and tests and responds in one serial loop, which is a different simulation from any N.
+  size_t threads;
+  // Simulate on a thread of its own at a fixed rate, while the window draws the latest snapshot at its own rate.
+  bool decouple;
+  // Directory the data files are written to.
+  const char *output;
+  // A sweep runs every count from sweepFrom up to sweepTo, each sweepFactor times the last, instead of one scene.
+  bool sweep;
+  size_t sweepFrom;
+  size_t sweepTo;
+  double sweepFactor;
+} Options;
+
+static const char *OPTIONS_USAGE =
+    "Usage: %s [options]\n"
+    "  -a, --algorithm NAME                collision engine, see below (sat)\n"
+    "  -b, --broadphase brute|grid|sap|bvh candidate pair search (the engine's default)\n"
+    "  -n, --objects N                     number of objects (800)\n"
+    "  -r, --run N                         number of the first run, used in the file names (8)\n"
+    "  -R, --runs N                        runs to simulate one after another (1)\n"
+    "  -f, --frames N                      frames recorded per run (500)\n"
+    "  -s, --seed N                        seed of the generated scene (1)\n"
+    "  -t, --dt SECONDS                    fixed time step (the frame time, 1 / fps without a window)\n"
+    "  -F, --fps N                         target frame rate (90)\n"
+    "  -o, --output DIR                    directory for the data files (./data)\n"
+    "  -x, --no-record                     do not write data files\n"
+    "  -B, --trace                         record compact binary traces instead of JSON\n"
+    "  -T, --tsc                           time with the calibrated TSC instead of the monotonic clock\n"
+    "  -j, --threads N                     simulate in stages on N work-stealing threads, with the same results for\n"
+    "                                      any N >= 1 (0: one serial loop, a different simulation from N >= 1)\n"
+    "  -d, --decouple                      simulate on its own thread at the fixed rate of --dt, while the window\n"
+    "                                      draws the latest snapshot at --fps\n"
+    "  -c, --counters                      record cycles, instructions, cache and branch misses per tick\n"
+    "                                      (of the calling thread only, not the other --threads)\n"
+    "  -S, --sweep FROM:TO                 time every object count from FROM to TO, each run --runs times,\n"
+    "                                      and write their statistics to one sweep file\n"
+    "  -g, --factor X                      ratio between the object counts of a sweep (2)\n"
+    "  -h, --help                          show this help\n"
+    "Engines (default broadphase):\n";
+
+static void printUsage(FILE *stream, const char *program) {
+  fprintf(stream, OPTIONS_USAGE, program);
+
+  for (size_t e = 0; e < ENGINE_COUNT; e++) {
+    fprintf(stream, "  %-35s %s\n", ENGINES[e]->name, broadphaseName(ENGINES[e]->defaultBroadphase));
+  }
+}
+
+// Parse a whole decimal number from min to max. Returns false if text is anything else.
+static bool parseNumber(const char *text, long min, long max, long *value) {
+  char *end;
+  errno = 0;
+  long parsed = strtol(text, &end, 10);
+
+  if (end == text || *end != '\0' || errno == ERANGE || parsed < min || parsed > max) {
+    return false;
+  }
+
+  *value = parsed;
+  return true;
+}
+
+// Parse a finite number greater than above and at most max. Returns false if text is anything else.
+static bool parseReal(const char *text, double above, double max, double *value) {
+  char *end;
+  double parsed = strtod(text, &end);
+
+  if (end == text || *end != '\0' || !isfinite(parsed) || parsed <= above || parsed > max) {
+    return false;
+  }
+
+  *value = parsed;
+  return true;
+}
+
+// Fill options from the command line, starting from the defaults.
+// Returns false after printing the usage if the arguments are invalid. --help prints it and exits.
+bool Options_parse(int argc, char **argv, Options *options) {
+  static const struct option longOptions[] = {
+      {"algorithm", required_argument, NULL, 'a'}, {"broadphase", required_argument, NULL, 'b'},
+      {"objects", required_argument, NULL, 'n'},   {"run", required_argument, NULL, 'r'},
+      {"runs", required_argument, NULL, 'R'},      {"frames", required_argument, NULL, 'f'},
+      {"seed", required_argument, NULL, 's'},      {"dt", required_argument, NULL, 't'},
+      {"fps", required_argument, NULL, 'F'},       {"output", required_argument, NULL, 'o'},
+      {"no-record", no_argument, NULL, 'x'},       {"sweep", required_argument, NULL, 'S'},
+      {"factor", required_argument, NULL, 'g'},    {"tsc", no_argument, NULL, 'T'},
+      {"counters", no_argument, NULL, 'c'},        {"trace", no_argument, NULL, 'B'},
+      {"threads", required_argument, NULL, 'j'},   {"decouple", no_argument, NULL, 'd'},
+      {"help", no_argument, NULL, 'h'},            {NULL, 0, NULL, 0}};
+
+  *options = (Options){.engine = &SAT_ENGINE,
+                       .objects = 800,
+                       .firstRun = 8,
+                       .runs = 1,
+                       .frames = 500,
+                       .seed = 1,
+                       .framerate = 90,
+                       .recording = true,
+                       .output = "./data",
+                       .sweepFactor = 2};
+  bool valid = true;
+  long number = 0;
+  double real = 0;
+  int option;
+
+  while (valid && (option = getopt_long(argc, argv, "a:b:n:r:R:f:s:t:F:o:xBS:g:Tcj:dh", longOptions, NULL)) != -1) {
+    switch (option) {
+    case 'a':
+      options->engine = findEngine(optarg);
+      options->algorithmGiven = true;
+      valid = options->engine != NULL;
+      break;
+    case 'b':
+      valid = broadphaseFromName(optarg, &options->broadphase);
+      options->broadphaseGiven = true;
+      break;
+    case 'n':
+      valid = parseNumber(optarg, 1, LONG_MAX, &number);
+      options->objects = (size_t)number;
+      break;
+    case 'r':
+      valid = parseNumber(optarg, 0, INT_MAX, &number);
+      options->firstRun = (int)number;
+      break;
+    case 'R':
+      valid = parseNumber(optarg, 1, INT_MAX, &number);
+      options->runs = (int)number;
+      break;
+    case 'f':
+      valid = parseNumber(optarg, 1, INT_MAX - 2, &number);
+      options->frames = (int)number;
+      break;
+    case 's':
+      valid = parseNumber(optarg, 0, LONG_MAX, &number);
+      options->seed = (uint64_t)number;
+      break;
+    case 't':
+      valid = parseReal(optarg, 0, FLT_MAX, &real);
+      options->dt = (float)real;
+      break;
+    case 'F':
+      valid = parseNumber(optarg, 1, INT_MAX, &number);
+      options->framerate = (int)number;
+      break;
+    case 'o':
+      options->output = optarg;
+      break;
+    case 'x':
+      options->recording = false;
+      break;
+    case 'B':
+      options->trace = true;
+      break;
+    case 'T':
+      options->tsc = true;
+      break;
+    case 'c':
+      options->counters = true;
+      break;
+    case 'j':
+      valid = parseNumber(optarg, 0, LONG_MAX, &number);
+      options->threads = (size_t)number;
+      break;
+    case 'd':
+      options->decouple = true;
+      break;
+    case 'S': {
+      char end;
+      options->sweep = true;
+      valid = sscanf(optarg, "%zu:%zu%c", &options->sweepFrom, &options->sweepTo, &end) == 2 &&
+              options->sweepFrom > 0 && options->sweepFrom <= options->sweepTo;
+      break;
+    }
+    case 'g':
+      valid = parseReal(optarg, 1, DBL_MAX, &real);
+      options->sweepFactor = real;
+      break;
+    case 'h':
+      printUsage(stdout, argv[0]);
+      exit(0);
+    default:
+      valid = false;
+      break;
+    }
+  }
+
+  if (!valid && option != '?') {
+    fprintf(stderr, "%s: invalid value '%s'\n", argv[0], optarg);
+  }
+
+  if (!valid || optind < argc) {
+    printUsage(stderr, argv[0]);
+    return false;
+  }
+
+  // Every engine defaults to the broadphase that suits it best.
+  if (!options->broadphaseGiven) {
+    options->broadphase = options->engine->defaultBroadphase;
+  }
+
+  return true;
+}
@@ -0,0 +1,106 @@
+// Batched overlap tests: one box against a block of boxes stored as structure-of-arrays, returning a bitmask of hits.
+// The kernel is picked at runtime from what the CPU supports, with a scalar fallback on other machines.
+
+#include <common.h>
+#include <stdbool.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define OVERLAP_X86 1
+#else
+#define OVERLAP_X86 0
+#endif
+
+#pragma once
+
+// Test box a against the boxes at x/y with extents w/h. Bit k of the result is set if a touches box k.
+typedef unsigned (*OverlapBatch)(Bounds a, const double x[], const double y[], const double w[], const double h[]);
+
+typedef struct {
+  OverlapBatch test;
+  // The number of boxes one call tests.
+  size_t lanes;
+  const char *name;
+} OverlapKernel;
+
+// Test up to 32 boxes. Touching boxes count as overlapping, like boundsOverlap.
+static unsigned overlapScalar(Bounds a, const double x[], const double y[], const double w[], const double h[],
+                              size_t count) {
+  unsigned mask = 0;
+
+  for (size_t k = 0; k < count; k++) {
+    bool hit = a.left <= x[k] + w[k] && a.right >= x[k] && a.top <= y[k] + h[k] && a.bottom >= y[k];
+    mask |= (unsigned)hit << k;
+  }
+
+  return mask;
+}
+
+static unsigned overlapBatchScalar(Bounds a, const double x[], const double y[], const double w[], const double h[]) {
+  return overlapScalar(a, x, y, w, h, 4);
+}
+
+#if OVERLAP_X86
+// Two boxes per 128-bit register, four boxes per call.
+__attribute__((target("sse2"))) static unsigned overlapBatchSSE2(Bounds a, const double x[], const double y[],
+                                                                 const double w[], const double h[]) {
+  __m128d left = _mm_set1_pd(a.left);
+  __m128d right = _mm_set1_pd(a.right);
+  __m128d top = _mm_set1_pd(a.top);
+  __m128d bottom = _mm_set1_pd(a.bottom);
+  unsigned mask = 0;
+
+  for (int k = 0; k < 4; k += 2) {
+    __m128d bLeft = _mm_loadu_pd(x + k);
+    __m128d bTop = _mm_loadu_pd(y + k);
+    __m128d bRight = _mm_add_pd(bLeft, _mm_loadu_pd(w + k));
+    __m128d bBottom = _mm_add_pd(bTop, _mm_loadu_pd(h + k));
+    __m128d xHit = _mm_and_pd(_mm_cmple_pd(left, bRight), _mm_cmpge_pd(right, bLeft));
+    __m128d yHit = _mm_and_pd(_mm_cmple_pd(top, bBottom), _mm_cmpge_pd(bottom, bTop));
+
+    mask |= (unsigned)_mm_movemask_pd(_mm_and_pd(xHit, yHit)) << k;
+  }
+
+  return mask;
+}
+
+// Four boxes per 256-bit register, eight boxes per call.
+__attribute__((target("avx2"))) static unsigned overlapBatchAVX2(Bounds a, const double x[], const double y[],
+                                                                 const double w[], const double h[]) {
+  __m256d left = _mm256_set1_pd(a.left);
+  __m256d right = _mm256_set1_pd(a.right);
+  __m256d top = _mm256_set1_pd(a.top);
+  __m256d bottom = _mm256_set1_pd(a.bottom);
+  unsigned mask = 0;
+
+  for (int k = 0; k < 8; k += 4) {
+    __m256d bLeft = _mm256_loadu_pd(x + k);
+    __m256d bTop = _mm256_loadu_pd(y + k);
+    __m256d bRight = _mm256_add_pd(bLeft, _mm256_loadu_pd(w + k));
+    __m256d bBottom = _mm256_add_pd(bTop, _mm256_loadu_pd(h + k));
+    __m256d xHit = _mm256_and_pd(_mm256_cmp_pd(left, bRight, _CMP_LE_OQ), _mm256_cmp_pd(right, bLeft, _CMP_GE_OQ));
+    __m256d yHit = _mm256_and_pd(_mm256_cmp_pd(top, bBottom, _CMP_LE_OQ), _mm256_cmp_pd(bottom, bTop, _CMP_GE_OQ));
+
+    mask |= (unsigned)_mm256_movemask_pd(_mm256_and_pd(xHit, yHit)) << k;
+  }
+
+  return mask;
+}
+#endif
+
+// Pick the widest kernel this CPU supports, asking CPUID through the compiler's builtin.
+OverlapKernel overlapKernel(void) {
+#if OVERLAP_X86
+  __builtin_cpu_init();
+
+  if (__builtin_cpu_supports("avx2")) {
+    return (OverlapKernel){overlapBatchAVX2, 8, "avx2"};
+  }
+
+  if (__builtin_cpu_supports("sse2")) {
+    return (OverlapKernel){overlapBatchSSE2, 4, "sse2"};
+  }
+#endif
+
+  return (OverlapKernel){overlapBatchScalar, 4, "scalar"};
+}
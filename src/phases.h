@@ -0,0 +1,86 @@
+// Where a tick goes: the simulate functions mark the phase they are in, and each phase adds up the time spent in it.
+// The markers cost SAT around a tenth of its tick, so they are compiled out unless built with PHASE_TIMING=1.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <timer.h>
+
+#pragma once
+
+#ifndef PHASE_TIMING
+#define PHASE_TIMING 0
+#endif
+
+typedef enum { GravityPhase = 0, WallPhase, BroadphasePhase, PairPhase, ResponsePhase, IntegratePhase } Phase;
+
+#define PHASE_COUNT (IntegratePhase + 1)
+// How deeply phases can nest, e.g. the response inside the pair tests.
+#define PHASE_MAX_DEPTH 4
+
+static const char *PHASE_NAMES[PHASE_COUNT] = {"gravity", "walls", "broadphase", "pairs", "response", "integrate"};
+
+#if PHASE_TIMING
+#define PHASE_BEGIN(phase) Phase_begin(phase)
+#define PHASE_SWITCH(phase) Phase_switch(phase)
+#define PHASE_END() Phase_end()
+#else
+#define PHASE_BEGIN(phase) ((void)0)
+#define PHASE_SWITCH(phase) ((void)0)
+#define PHASE_END() ((void)0)
+#endif
+
+// In Timer_stamp units.
+static uint64_t phaseStamps[PHASE_COUNT];
+static Phase phaseStack[PHASE_MAX_DEPTH];
+static size_t phaseDepth;
+static uint64_t phaseSince;
+
+// Charge the time since the last marker to the innermost phase, so every phase only counts its own time.
+static void Phase_charge(void) {
+  uint64_t now = Timer_stamp();
+
+  if (phaseDepth > 0) {
+    phaseStamps[phaseStack[phaseDepth - 1]] += now - phaseSince;
+  }
+
+  phaseSince = now;
+}
+
+// Enter phase, pausing the phase it is nested in.
+void Phase_begin(Phase phase) {
+  Phase_charge();
+
+  if (phaseDepth < PHASE_MAX_DEPTH) {
+    phaseStack[phaseDepth++] = phase;
+  }
+}
+
+// Leave the innermost phase for phase, reading the clock once.
+void Phase_switch(Phase phase) {
+  Phase_charge();
+
+  if (phaseDepth > 0) {
+    phaseStack[phaseDepth - 1] = phase;
+  }
+}
+
+// Leave the innermost phase, resuming the one it was nested in.
+void Phase_end(void) {
+  Phase_charge();
+
+  if (phaseDepth > 0) {
+    phaseDepth--;
+  }
+}
+
+// Zero every phase, e.g. before a tick.
+void Phase_reset(void) {
+  for (size_t p = 0; p < PHASE_COUNT; p++) {
+    phaseStamps[p] = 0;
+  }
+
+  phaseDepth = 0;
+}
+
+// Nanoseconds spent in phase since the last reset.
+uint64_t Phase_nanoseconds(Phase phase) { return (uint64_t)Timer_stampNanoseconds(phaseStamps[phase]); }
@@ -0,0 +1,40 @@
+// PCG32 (https://www.pcg-random.org): a small, fast pseudorandom generator whose sequence only depends on its seed,
+// on every platform, unlike rand().
+
+#include <stdint.h>
+
+#pragma once
+
+typedef struct {
+  uint64_t state;
+  uint64_t increment;
+} Random;
+
+uint32_t Random_next(Random *random) {
+  uint64_t old = random->state;
+  random->state = old * 6364136223846793005ULL + random->increment;
+
+  uint32_t xorShifted = (uint32_t)(((old >> 18u) ^ old) >> 27u);
+  uint32_t rotation = (uint32_t)(old >> 59u);
+  return (xorShifted >> rotation) | (xorShifted << ((-rotation) & 31));
+}
+
+// Seed the generator on PCG's default stream.
+Random Random_create(uint64_t seed) {
+  Random random = {0, (0xda3e39cb94b95bdbULL << 1u) | 1u};
+
+  Random_next(&random);
+  random.state += seed;
+  Random_next(&random);
+  return random;
+}
+
+// Uniform in [min, max).
+double Random_range(Random *random, double min, double max) {
+  return min + (max - min) * (Random_next(random) * 0x1p-32);
+}
+
+// Uniform in [min, max], both included.
+int Random_int(Random *random, int min, int max) {
+  return min + (int)(((uint64_t)Random_next(random) * (uint64_t)(max - min + 1)) >> 32);
+}
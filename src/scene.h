@@ -0,0 +1,55 @@
+// The scene every engine simulates. A seed always gives the same objects, whichever engine builds them, so engines
+// and runs can be compared on the same workload.
+
+#include <common.h>
+#include <math.h>
+#include <random.h>
+#include <raylib.h>
+#include <stdbool.h>
+
+#pragma once
+
+// Polygons get between 3 and this many sides.
+#define SCENE_MAX_SIDES 8
+
+typedef struct {
+  // Top-left corner of the bounding box, in meters.
+  double x;
+  double y;
+  double dx;
+  double dy;
+  // Full extents of the bounding box.
+  double width;
+  double height;
+  double mass;
+  Color col;
+  // AABB makes round objects circles and the others rectangles.
+  bool round;
+  // SAT makes every object a regular polygon with this many sides.
+  int sides;
+} SceneObject;
+
+// Fill objects with count objects generated from seed.
+// The objects shrink as the count grows, so together they always cover about the same area.
+void Scene_generate(SceneObject objects[], size_t count, uint64_t seed) {
+  Random random = Random_create(seed);
+
+  for (size_t i = 0; i < count; i++) {
+    SceneObject *object = &objects[i];
+
+    // Draw every field of every object, so an object never depends on which fields the engine uses.
+    object->x = Random_range(&random, 1, 5);
+    object->y = Random_range(&random, 1, 5);
+    object->dx = Random_range(&random, -1, 2);
+    object->dy = Random_range(&random, -1, 2);
+    object->width = fmax(1 / SCALE, 3 * Random_range(&random, 0.5, 1) / sqrt((double)count));
+    object->height = fmax(1 / SCALE, 3 * Random_range(&random, 0.5, 1) / sqrt((double)count));
+    object->mass = Random_range(&random, 1, 5);
+    object->col.r = Random_int(&random, 100, 230);
+    object->col.g = Random_int(&random, 100, 230);
+    object->col.b = Random_int(&random, 100, 230);
+    object->col.a = 255;
+    object->round = Random_int(&random, 0, 1);
+    object->sides = Random_int(&random, 3, SCENE_MAX_SIDES);
+  }
+}
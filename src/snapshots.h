@@ -0,0 +1,97 @@
+// Triple-buffered snapshots of the object positions, handed from the simulation thread to the render thread.
+// The simulation fills the back buffer and swaps it with the ready one, the renderer swaps the ready one with the one
+// it draws whenever a newer one was published. Neither side ever waits for the other to finish with a buffer, only
+// for the swap of two pointers.
+
+#include <common.h>
+#include <pthread.h>
+#include <raylib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#pragma once
+
+typedef struct {
+  Vector2 *positions;
+  // The tick that produced it, counting from 1, 0 for the scene before the first tick.
+  uint64_t tick;
+  // What that tick took, in nanoseconds.
+  uint64_t tickTime;
+  uint64_t phases[PHASE_COUNT];
+} Snapshot;
+
+typedef struct {
+  Snapshot buffers[3];
+  pthread_mutex_t lock;
+  // Filled in by the simulation.
+  Snapshot *back;
+  // The latest published one.
+  Snapshot *ready;
+  // Drawn by the renderer.
+  Snapshot *front;
+  // Set if ready is newer than front.
+  bool fresh;
+} Snapshots;
+
+void Snapshots_free(Snapshots *snapshots) {
+  for (size_t b = 0; b < 3; b++) {
+    free(snapshots->buffers[b].positions);
+  }
+
+  pthread_mutex_destroy(&snapshots->lock);
+  *snapshots = (Snapshots){0};
+}
+
+// Make room for the positions of count objects in every buffer, and fill them all from first so the renderer has
+// something to draw before the first tick. Returns false if an allocation failed.
+bool Snapshots_create(Snapshots *snapshots, size_t count, const Vector2 first[]) {
+  *snapshots = (Snapshots){0};
+  pthread_mutex_init(&snapshots->lock, NULL);
+
+  for (size_t b = 0; b < 3; b++) {
+    snapshots->buffers[b].positions = (Vector2 *)calloc(count ? count : 1, sizeof(Vector2));
+
+    if (!snapshots->buffers[b].positions) {
+      Snapshots_free(snapshots);
+      return false;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+      snapshots->buffers[b].positions[i] = first[i];
+    }
+  }
+
+  snapshots->back = &snapshots->buffers[0];
+  snapshots->ready = &snapshots->buffers[1];
+  snapshots->front = &snapshots->buffers[2];
+  return true;
+}
+
+// The buffer for the simulation to fill before Snapshots_publish.
+Snapshot *Snapshots_back(Snapshots *snapshots) { return snapshots->back; }
+
+// Make the filled back buffer the latest snapshot.
+void Snapshots_publish(Snapshots *snapshots) {
+  pthread_mutex_lock(&snapshots->lock);
+  Snapshot *published = snapshots->back;
+  snapshots->back = snapshots->ready;
+  snapshots->ready = published;
+  snapshots->fresh = true;
+  pthread_mutex_unlock(&snapshots->lock);
+}
+
+// The latest published snapshot, which stays untouched until the next call.
+const Snapshot *Snapshots_latest(Snapshots *snapshots) {
+  pthread_mutex_lock(&snapshots->lock);
+
+  if (snapshots->fresh) {
+    Snapshot *latest = snapshots->ready;
+    snapshots->ready = snapshots->front;
+    snapshots->front = latest;
+    snapshots->fresh = false;
+  }
+
+  pthread_mutex_unlock(&snapshots->lock);
+  return snapshots->front;
+}
@@ -0,0 +1,70 @@
+// Summary statistics of tick times, and the power law fitted through a scaling sweep.
+
+#include <common.h>
+#include <math.h>
+#include <stdlib.h>
+
+#pragma once
+
+static int compareDoubles(const void *a, const void *b) {
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+
+  return (x > y) - (x < y);
+}
+
+// The sample at fraction q (0..1) of the sorted samples, by the nearest-rank method.
+static double sortedPercentile(const double sorted[], size_t count, double q) {
+  size_t rank = (size_t)ceil(q * count);
+
+  return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+// Summarize count samples, sorting them in place. count must not be 0.
+TickStats tickStats(double samples[], size_t count) {
+  double sum = 0;
+
+  qsort(samples, count, sizeof(double), compareDoubles);
+
+  for (size_t i = 0; i < count; i++) {
+    sum += samples[i];
+  }
+
+  double mean = sum / count;
+  double squares = 0;
+
+  for (size_t i = 0; i < count; i++) {
+    squares += (samples[i] - mean) * (samples[i] - mean);
+  }
+
+  double median = count % 2 ? samples[count / 2] : (samples[count / 2 - 1] + samples[count / 2]) / 2;
+
+  return (TickStats){.mean = mean,
+                     .median = median,
+                     .p95 = sortedPercentile(samples, count, 0.95),
+                     .p99 = sortedPercentile(samples, count, 0.99),
+                     .stddev = count > 1 ? sqrt(squares / (count - 1)) : 0};
+}
+
+// Fit time = c * N^k by least squares on log(time) against log(N), and return k.
+// Needs at least two different object counts, returns NAN otherwise.
+double fitExponent(const SweepPoint points[], size_t count) {
+  double sumX = 0;
+  double sumY = 0;
+  double sumXX = 0;
+  double sumXY = 0;
+
+  for (size_t i = 0; i < count; i++) {
+    double x = log((double)points[i].objectCount);
+    double y = log(points[i].ticks.mean);
+
+    sumX += x;
+    sumY += y;
+    sumXX += x * x;
+    sumXY += x * y;
+  }
+
+  double denominator = count * sumXX - sumX * sumX;
+
+  return count > 1 && denominator > 0 ? (count * sumXY - sumX * sumY) / denominator : NAN;
+}
@@ -0,0 +1,95 @@
+// Sort-and-sweep (sweep-and-prune) broadphase along the x-axis.
+
+#include <common.h>
+#include <stdlib.h>
+#include <utils.h>
+
+#pragma once
+
+typedef struct {
+  // Cached copy of bounds[index].left, so sorting only touches this array.
+  double left;
+  size_t index;
+} SweepEntry;
+
+typedef struct {
+  // Every object ordered by its left edge, kept from frame to frame.
+  SweepEntry *entries;
+  size_t count;
+  size_t capacity;
+} Sweep;
+
+static int compareSweepEntries(const void *a, const void *b) {
+  double leftA = ((const SweepEntry *)a)->left;
+  double leftB = ((const SweepEntry *)b)->left;
+
+  return (leftA > leftB) - (leftA < leftB);
+}
+
+void Sweep_free(Sweep *sweep) {
+  free(sweep->entries);
+  *sweep = (Sweep){0};
+}
+
+// Sort the objects by their left edge and emit every pair whose bounds overlap.
+// The order from the previous frame is repaired with an insertion sort, which is close to linear since the objects
+// only move a little per frame. A changed object count starts over with a full sort.
+// Returns false if an allocation failed.
+bool Sweep_findPairs(Sweep *sweep, const Bounds bounds[], size_t count, CandidatePair **pairs, size_t *pairCount,
+                     size_t *pairCapacity) {
+  *pairCount = 0;
+
+  if (sweep->count != count) {
+    if (!reserveArray((void **)&sweep->entries, &sweep->capacity, count, sizeof(SweepEntry))) {
+      return false;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+      sweep->entries[i] = (SweepEntry){bounds[i].left, i};
+    }
+
+    qsort(sweep->entries, count, sizeof(SweepEntry), compareSweepEntries);
+    sweep->count = count;
+  } else {
+    SweepEntry *entries = sweep->entries;
+
+    for (size_t p = 0; p < count; p++) {
+      entries[p].left = bounds[entries[p].index].left;
+    }
+
+    for (size_t p = 1; p < count; p++) {
+      SweepEntry entry = entries[p];
+      size_t q = p;
+
+      while (q > 0 && entries[q - 1].left > entry.left) {
+        entries[q] = entries[q - 1];
+        q--;
+      }
+
+      entries[q] = entry;
+    }
+  }
+
+  // ---------- Sweep. ----------
+  // Every object starting before the current one's right edge overlaps it on the x-axis.
+  for (size_t p = 0; p < count; p++) {
+    size_t a = sweep->entries[p].index;
+    double right = bounds[a].right;
+
+    for (size_t q = p + 1; q < count && sweep->entries[q].left <= right; q++) {
+      size_t b = sweep->entries[q].index;
+
+      if (!boundsOverlap(bounds[a], bounds[b])) {
+        continue;
+      }
+
+      if (!reserveArray((void **)pairs, pairCapacity, *pairCount + 1, sizeof(CandidatePair))) {
+        return false;
+      }
+
+      (*pairs)[(*pairCount)++] = a < b ? (CandidatePair){a, b} : (CandidatePair){b, a};
+    }
+  }
+
+  return true;
+}
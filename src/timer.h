@@ -0,0 +1,99 @@
+// Wall-clock timestamps in nanoseconds for timing the simulation.
+// The default is the monotonic clock. Timer_useTSC switches to the x86 time-stamp counter, calibrated against it,
+// which is cheaper to read around short ticks.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define TIMER_X86 1
+#else
+#define TIMER_X86 0
+#endif
+
+#pragma once
+
+static bool timerUsesTSC;
+static uint64_t timerTSCStart;
+static uint64_t timerNanosecondsStart;
+static double timerNanosecondsPerCycle;
+
+static uint64_t monotonicNanoseconds(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+#if TIMER_X86
+// The fences keep the read from moving across the code being timed.
+static uint64_t readTSC(void) {
+  _mm_lfence();
+  uint64_t cycles = __rdtsc();
+  _mm_lfence();
+  return cycles;
+}
+#endif
+
+// Nanoseconds since an arbitrary point, on whichever clock is in use. Only differences are meaningful.
+uint64_t Timer_nanoseconds(void) {
+#if TIMER_X86
+  if (timerUsesTSC) {
+    return timerNanosecondsStart + (uint64_t)((readTSC() - timerTSCStart) * timerNanosecondsPerCycle);
+  }
+#endif
+
+  return monotonicNanoseconds();
+}
+
+// A cheaper, unordered timestamp for marking many short intervals, such as the phases of a tick: the raw TSC when
+// it is in use, otherwise monotonic nanoseconds. Turn differences into nanoseconds with Timer_stampNanoseconds.
+uint64_t Timer_stamp(void) {
+#if TIMER_X86
+  if (timerUsesTSC) {
+    return __rdtsc();
+  }
+#endif
+
+  return monotonicNanoseconds();
+}
+
+double Timer_stampNanoseconds(uint64_t stamps) { return timerUsesTSC ? stamps * timerNanosecondsPerCycle : stamps; }
+
+// Switch to the time-stamp counter, measuring its rate against the monotonic clock for calibrationMilliseconds.
+// Returns false, keeping the monotonic clock, if the CPU has no invariant TSC: one that ticks at a constant rate
+// whatever the core's frequency or sleep state.
+bool Timer_useTSC(unsigned calibrationMilliseconds) {
+#if TIMER_X86
+  unsigned eax, ebx, ecx, edx;
+
+  if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) || !(edx & (1u << 8))) {
+    return false;
+  }
+
+  uint64_t nanosecondsStart = monotonicNanoseconds();
+  uint64_t cyclesStart = readTSC();
+  uint64_t nanoseconds;
+
+  do {
+    nanoseconds = monotonicNanoseconds();
+  } while (nanoseconds - nanosecondsStart < calibrationMilliseconds * 1000000ull);
+
+  uint64_t cycles = readTSC();
+
+  timerNanosecondsPerCycle = (double)(nanoseconds - nanosecondsStart) / (double)(cycles - cyclesStart);
+  timerTSCStart = cycles;
+  timerNanosecondsStart = nanoseconds;
+  timerUsesTSC = true;
+  return true;
+#else
+  (void)calibrationMilliseconds;
+  return false;
+#endif
+}
+
+// The TSC's rate found by Timer_useTSC, in GHz, or 0 on the monotonic clock.
+double Timer_TSCGigahertz(void) { return timerUsesTSC ? 1 / timerNanosecondsPerCycle : 0; }
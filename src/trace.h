@@ -0,0 +1,121 @@
+// Binary traces of a run: a header describing the run, then one fixed-size record per recorded tick.
+// Recording only copies each point into a buffered file, the converter in tools/ turns a trace into the JSON data
+// file or CSV afterwards. Numbers are stored in the byte order of the machine that recorded them.
+
+#include <common.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#pragma once
+
+#define TRACE_MAGIC "CBTRACE"
+// Bump whenever TraceHeader or TraceRecord change.
+#define TRACE_VERSION 2
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  // sizeof(TraceRecord) and the array lengths in it, so a reader built with other phases or counters refuses it.
+  uint32_t recordSize;
+  uint32_t phaseCount;
+  uint32_t counterCount;
+  // Bit c is set if counter c was recorded.
+  uint32_t counters;
+  uint32_t phaseTiming;
+  uint32_t headless;
+  int32_t run;
+  // Threads the pairs were tested on, 0 for the serial loop.
+  uint32_t threads;
+  uint64_t seed;
+  uint64_t objectCount;
+  // Fixed time step in seconds, 0 if each tick used the last frame time.
+  double dt;
+  // Rate of the time-stamp counter the ticks were timed with, 0 for the monotonic clock.
+  double tscGigahertz;
+  char engine[32];
+  char broadphase[16];
+} TraceHeader;
+
+// A JSONDataPoint with fixed-width fields. Times are in nanoseconds.
+typedef struct {
+  uint64_t time;
+  uint64_t tick;
+  uint64_t allocations;
+  double fps;
+  uint64_t phases[PHASE_COUNT];
+  uint64_t counters[COUNTER_COUNT];
+} TraceRecord;
+
+typedef struct {
+  FILE *file;
+} Trace;
+
+// Fill in the fields of a header that describe the format, the caller fills in the run.
+TraceHeader Trace_header(void) {
+  TraceHeader header = {.version = TRACE_VERSION,
+                        .recordSize = sizeof(TraceRecord),
+                        .phaseCount = PHASE_COUNT,
+                        .counterCount = COUNTER_COUNT};
+  memcpy(header.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+  return header;
+}
+
+// Create path and write the header. Returns false if it could not be written.
+bool Trace_open(Trace *trace, const char *path, const TraceHeader *header) {
+  trace->file = fopen(path, "wb");
+
+  if (!trace->file) {
+    return false;
+  }
+
+  setvbuf(trace->file, NULL, _IOFBF, 1 << 16);
+
+  if (fwrite(header, sizeof(*header), 1, trace->file) != 1) {
+    fclose(trace->file);
+    trace->file = NULL;
+    return false;
+  }
+
+  return true;
+}
+
+void Trace_write(Trace *trace, const JSONDataPoint *point) {
+  TraceRecord record = {.time = point->time, .tick = point->tick, .allocations = point->allocations, .fps = point->fps};
+  memcpy(record.phases, point->phases, sizeof(record.phases));
+  memcpy(record.counters, point->counters, sizeof(record.counters));
+  fwrite(&record, sizeof(record), 1, trace->file);
+}
+
+// Returns false if any write failed.
+bool Trace_close(Trace *trace) {
+  bool written = !ferror(trace->file);
+  written = fclose(trace->file) == 0 && written;
+  trace->file = NULL;
+  return written;
+}
+
+// Read and check the header of a trace opened for reading.
+// Returns false if the file is not a trace this build can read.
+bool Trace_readHeader(FILE *file, TraceHeader *header) {
+  return fread(header, sizeof(*header), 1, file) == 1 &&
+         memcmp(header->magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) == 0 && header->version == TRACE_VERSION &&
+         header->recordSize == sizeof(TraceRecord) && header->phaseCount == PHASE_COUNT &&
+         header->counterCount == COUNTER_COUNT;
+}
+
+// Read the next record into point. Returns false at the end of the trace.
+bool Trace_readPoint(FILE *file, JSONDataPoint *point) {
+  TraceRecord record;
+
+  if (fread(&record, sizeof(record), 1, file) != 1) {
+    return false;
+  }
+
+  *point = (JSONDataPoint){
+      .time = record.time, .fps = record.fps, .tick = record.tick, .allocations = (size_t)record.allocations};
+  memcpy(point->phases, record.phases, sizeof(point->phases));
+  memcpy(point->counters, record.counters, sizeof(point->counters));
+  return true;
+}
@@ -1,62 +1,156 @@
 #include <cJSON.h>
 #include <common.h>
+#include <inttypes.h>
 #include <math.h>
 #include <raymath.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #pragma once
 
-// Flatten two Vector2 arrays into one array.
-Vector2 *concatVector2Arrays(const Vector2 *a, size_t len_a, const Vector2 *b, size_t len_b) {
-  size_t len_c = len_a + len_b;
-  Vector2 *c = malloc(len_c * sizeof(Vector2));
+// Grow a heap array to hold at least count elements, keeping its contents.
+// Returns false if the allocation failed, in which case the array is left untouched.
+static inline bool reserveArray(void **array, size_t *capacity, size_t count, size_t size) {
+  if (count <= *capacity) {
+    return true;
+  }
+
+  size_t newCapacity = *capacity ? *capacity : 64;
 
-  if (!c) {
-    // Allocation failed.
-    return NULL;
+  while (newCapacity < count) {
+    newCapacity *= 2;
   }
 
-  // Copy elements of a.
-  for (size_t i = 0; i < len_a; i++) {
-    c[i] = a[i];
+  void *grown = realloc(*array, newCapacity * size);
+
+  if (!grown) {
+    return false;
   }
-  // Copy elements of b.
-  for (size_t j = 0; j < len_b; j++) {
-    c[len_a + j] = b[j];
+
+  *array = grown;
+  *capacity = newCapacity;
+  return true;
+}
+
+// Touching bounds count as overlapping, circles collide when they touch.
+static inline bool boundsOverlap(Bounds a, Bounds b) {
+  return a.left <= b.right && a.right >= b.left && a.top <= b.bottom && a.bottom >= b.top;
+}
+
+// Writes the data points of a run to a JSON file one at a time, as they are recorded, through a fixed-size buffer.
+// Memory stays the same however many points a run records.
+typedef struct {
+  FILE *file;
+  size_t points;
+  // Write the time of each phase.
+  bool phases;
+  // Bit c is set if counter c is written, 0 leaves the counters out.
+  unsigned counters;
+} DataStream;
+
+// Open path and start the file. Returns false if it could not be opened.
+bool DataStream_open(DataStream *stream, const char *path, size_t objectCount, bool phases, unsigned counters) {
+  *stream = (DataStream){.file = fopen(path, "w"), .phases = phases, .counters = counters};
+
+  if (!stream->file) {
+    return false;
   }
 
-  return c;
+  setvbuf(stream->file, NULL, _IOFBF, 1 << 16);
+  fprintf(stream->file, "{\n\t\"object_count\":\t%zu,\n\t\"points\":\t[", objectCount);
+  return true;
 }
 
-// https://github.com/DaveGamble/cJSON?tab=readme-ov-file#printing
+// Append one point. Times are written in seconds, to the nanosecond.
+void DataStream_write(DataStream *stream, const JSONDataPoint *point) {
+  FILE *file = stream->file;
+
+  fprintf(file, "%s\n\t\t{\"time\": %.9f, \"fps\": %.9g, \"tick\": %.9f, \"allocations\": %zu",
+          stream->points ? "," : "", point->time / 1e9, point->fps, point->tick / 1e9, point->allocations);
+
+  if (stream->phases) {
+    for (size_t p = 0; p < PHASE_COUNT; p++) {
+      fprintf(file, "%s\"%s\": %.9f", p == 0 ? ", \"phases\": {" : ", ", PHASE_NAMES[p], point->phases[p] / 1e9);
+    }
+
+    fputc('}', file);
+  }
+
+  if (stream->counters) {
+    const char *separator = ", \"counters\": {";
+
+    for (size_t c = 0; c < COUNTER_COUNT; c++) {
+      if (stream->counters & (1u << c)) {
+        fprintf(file, "%s\"%s\": %" PRIu64, separator, COUNTER_NAMES[c], point->counters[c]);
+        separator = ", ";
+      }
+    }
+
+    fputc('}', file);
+  }
+
+  fputc('}', file);
+  stream->points++;
+}
+
+// Finish and close the file. Returns false if any write failed.
+bool DataStream_close(DataStream *stream) {
+  fputs("\n\t]\n}\n", stream->file);
+
+  bool written = !ferror(stream->file);
+  written = fclose(stream->file) == 0 && written;
+  *stream = (DataStream){0};
+  return written;
+}
+
+// Consolidate the series of a scaling sweep, runs repetitions of frames ticks per point, tick times in seconds.
 // NOTE: Returns a heap allocated string, you are required to free it after use.
-char *dataToJSON(JSONData data, size_t pointCount) {
+char *sweepToJSON(const SweepSeries series[], size_t seriesCount, int runs, int frames) {
   char *string = NULL;
-  cJSON *points = NULL;
   cJSON *jsonFile = cJSON_CreateObject();
+  cJSON *seriesArray = NULL;
 
-  if (cJSON_AddNumberToObject(jsonFile, "object_count", data.object_count) == NULL) {
+  if (cJSON_AddNumberToObject(jsonFile, "runs", runs) == NULL ||
+      cJSON_AddNumberToObject(jsonFile, "frames", frames) == NULL) {
     goto end;
   }
 
-  points = cJSON_AddArrayToObject(jsonFile, "points");
+  seriesArray = cJSON_AddArrayToObject(jsonFile, "series");
 
-  if (points == NULL) {
+  if (seriesArray == NULL) {
     goto end;
   }
 
-  for (size_t i = 0; i < pointCount; i++) {
-    cJSON *point = cJSON_CreateObject();
+  for (size_t s = 0; s < seriesCount; s++) {
+    cJSON *entry = cJSON_CreateObject();
+    cJSON_AddItemToArray(seriesArray, entry);
 
-    if (cJSON_AddNumberToObject(point, "time", data.points[i].time / 1000000) == NULL) {
+    if (cJSON_AddStringToObject(entry, "algorithm", series[s].algorithm) == NULL ||
+        cJSON_AddStringToObject(entry, "broadphase", series[s].broadphase) == NULL ||
+        cJSON_AddNumberToObject(entry, "exponent", series[s].exponent) == NULL) {
       goto end;
     }
 
-    if (cJSON_AddNumberToObject(point, "fps", data.points[i].fps) == NULL) {
+    cJSON *points = cJSON_AddArrayToObject(entry, "points");
+
+    if (points == NULL) {
       goto end;
     }
 
-    cJSON_AddItemToArray(points, point);
+    for (size_t i = 0; i < series[s].pointCount; i++) {
+      SweepPoint sweepPoint = series[s].points[i];
+      cJSON *point = cJSON_CreateObject();
+      cJSON_AddItemToArray(points, point);
+
+      if (cJSON_AddNumberToObject(point, "object_count", sweepPoint.objectCount) == NULL ||
+          cJSON_AddNumberToObject(point, "mean", sweepPoint.ticks.mean) == NULL ||
+          cJSON_AddNumberToObject(point, "median", sweepPoint.ticks.median) == NULL ||
+          cJSON_AddNumberToObject(point, "p95", sweepPoint.ticks.p95) == NULL ||
+          cJSON_AddNumberToObject(point, "p99", sweepPoint.ticks.p99) == NULL ||
+          cJSON_AddNumberToObject(point, "stddev", sweepPoint.ticks.stddev) == NULL) {
+        goto end;
+      }
+    }
   }
 
   string = cJSON_Print(jsonFile);
@@ -68,4 +162,4 @@ char *dataToJSON(JSONData data, size_t pointCount) {
 end:
   cJSON_Delete(jsonFile);
   return string;
-}
\ No newline at end of file
+}
@@ -0,0 +1,260 @@
+// A small work-stealing scheduler: a fixed pool of threads that run parallel-for loops over index ranges.
+// A loop is cut into chunks, and every worker starts with a deque of consecutive chunks. It takes chunks from the
+// back of its own deque and, once that is empty, steals from the front of the others', so a worker stuck with the
+// expensive end of a range is helped out by the rest. Workers park on a condition variable between loops.
+// The calling thread takes part as worker 0, so a pool of one thread starts no threads at all.
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <timer.h>
+
+#pragma once
+
+// Run the iterations begin..end of a loop.
+typedef void (*RangeJob)(void *context, size_t begin, size_t end);
+
+// What a worker did since the last Workers_resetStats.
+typedef struct {
+  // Timer_stamp units spent running chunks, see Workers_busyNanoseconds.
+  uint64_t busy;
+  uint64_t chunks;
+  // Chunks taken from another worker's deque.
+  uint64_t steals;
+} WorkerStats;
+
+typedef struct Workers Workers;
+
+typedef struct {
+  Workers *workers;
+  size_t index;
+  pthread_t thread;
+  // The chunks top..bottom are left in this worker's deque. The owner takes from the bottom, thieves from the top.
+  pthread_mutex_t lock;
+  size_t top;
+  size_t bottom;
+  WorkerStats stats;
+} Worker;
+
+struct Workers {
+  // Workers including the calling thread.
+  size_t count;
+  Worker *workers;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  pthread_cond_t done;
+  // Bumped for every loop, so a parked worker knows it has not joined it yet.
+  unsigned long generation;
+  // Started threads that have not finished the current loop.
+  size_t busy;
+  bool stopping;
+  // The current loop.
+  RangeJob job;
+  void *context;
+  size_t iterations;
+  size_t grain;
+};
+
+// Take the next chunk of worker victim's deque: its last one if thief is the owner, otherwise its first one.
+static bool Workers_take(Worker *victim, bool owner, size_t *chunk) {
+  bool taken = false;
+
+  pthread_mutex_lock(&victim->lock);
+
+  if (victim->top < victim->bottom) {
+    *chunk = owner ? --victim->bottom : victim->top++;
+    taken = true;
+  }
+
+  pthread_mutex_unlock(&victim->lock);
+  return taken;
+}
+
+// Run chunks of the current loop until every deque is empty. Chunks never add more chunks, so an empty sweep over
+// all the deques means the loop has no work left to hand out.
+static void Workers_work(Workers *workers, size_t self) {
+  Worker *worker = &workers->workers[self];
+
+  while (true) {
+    size_t chunk;
+    bool stolen = false;
+    bool found = Workers_take(worker, true, &chunk);
+
+    for (size_t v = 1; !found && v < workers->count; v++) {
+      found = stolen = Workers_take(&workers->workers[(self + v) % workers->count], false, &chunk);
+    }
+
+    if (!found) {
+      return;
+    }
+
+    size_t begin = chunk * workers->grain;
+    size_t end = begin + workers->grain < workers->iterations ? begin + workers->grain : workers->iterations;
+    uint64_t start = Timer_stamp();
+
+    workers->job(workers->context, begin, end);
+
+    worker->stats.busy += Timer_stamp() - start;
+    worker->stats.chunks++;
+    worker->stats.steals += stolen;
+  }
+}
+
+static void *Workers_loop(void *argument) {
+  Worker *self = (Worker *)argument;
+  Workers *workers = self->workers;
+  unsigned long seen = 0;
+
+  pthread_mutex_lock(&workers->lock);
+
+  while (true) {
+    while (workers->generation == seen && !workers->stopping) {
+      pthread_cond_wait(&workers->wake, &workers->lock);
+    }
+
+    if (workers->stopping) {
+      break;
+    }
+
+    seen = workers->generation;
+    pthread_mutex_unlock(&workers->lock);
+
+    Workers_work(workers, self->index);
+
+    pthread_mutex_lock(&workers->lock);
+
+    if (--workers->busy == 0) {
+      pthread_cond_signal(&workers->done);
+    }
+  }
+
+  pthread_mutex_unlock(&workers->lock);
+  return NULL;
+}
+
+// Stop and join every started thread.
+void Workers_stop(Workers *workers) {
+  if (workers->count > 1) {
+    pthread_mutex_lock(&workers->lock);
+    workers->stopping = true;
+    pthread_cond_broadcast(&workers->wake);
+    pthread_mutex_unlock(&workers->lock);
+
+    for (size_t w = 1; w < workers->count; w++) {
+      pthread_join(workers->workers[w].thread, NULL);
+    }
+  }
+
+  if (workers->workers) {
+    for (size_t w = 0; w < workers->count; w++) {
+      pthread_mutex_destroy(&workers->workers[w].lock);
+    }
+
+    pthread_mutex_destroy(&workers->lock);
+    pthread_cond_destroy(&workers->wake);
+    pthread_cond_destroy(&workers->done);
+  }
+
+  free(workers->workers);
+  *workers = (Workers){0};
+}
+
+// Start count - 1 threads in place, the pool must not move while they run.
+// Returns false if they could not all be started, in which case none are left running.
+bool Workers_start(Workers *workers, size_t count) {
+  *workers = (Workers){.count = 1};
+  workers->workers = (Worker *)calloc(count > 1 ? count : 1, sizeof(Worker));
+
+  if (!workers->workers) {
+    return false;
+  }
+
+  pthread_mutex_init(&workers->lock, NULL);
+  pthread_cond_init(&workers->wake, NULL);
+  pthread_cond_init(&workers->done, NULL);
+  workers->workers[0] = (Worker){.workers = workers, .index = 0};
+  pthread_mutex_init(&workers->workers[0].lock, NULL);
+
+  for (size_t w = 1; w < count; w++) {
+    workers->workers[w] = (Worker){.workers = workers, .index = w};
+    pthread_mutex_init(&workers->workers[w].lock, NULL);
+
+    if (pthread_create(&workers->workers[w].thread, NULL, Workers_loop, &workers->workers[w]) != 0) {
+      pthread_mutex_destroy(&workers->workers[w].lock);
+      Workers_stop(workers);
+      return false;
+    }
+
+    workers->count = w + 1;
+  }
+
+  return true;
+}
+
+// Run job over the iterations 0..iterations in chunks of grain, spread over the workers, and wait for all of them.
+// A NULL pool, or a loop of a single chunk, runs on the calling thread alone.
+void Workers_parallelFor(Workers *workers, size_t iterations, size_t grain, RangeJob job, void *context) {
+  if (!workers) {
+    job(context, 0, iterations);
+    return;
+  }
+
+  if (workers->count == 1 || iterations <= grain) {
+    WorkerStats *stats = &workers->workers[0].stats;
+    uint64_t start = Timer_stamp();
+
+    job(context, 0, iterations);
+
+    stats->busy += Timer_stamp() - start;
+    stats->chunks++;
+    return;
+  }
+
+  size_t chunks = (iterations + grain - 1) / grain;
+
+  pthread_mutex_lock(&workers->lock);
+  workers->job = job;
+  workers->context = context;
+  workers->iterations = iterations;
+  workers->grain = grain;
+
+  // Every worker starts with its own share of consecutive chunks.
+  for (size_t w = 0; w < workers->count; w++) {
+    Worker *worker = &workers->workers[w];
+
+    pthread_mutex_lock(&worker->lock);
+    worker->top = chunks * w / workers->count;
+    worker->bottom = chunks * (w + 1) / workers->count;
+    pthread_mutex_unlock(&worker->lock);
+  }
+
+  workers->busy = workers->count - 1;
+  workers->generation++;
+  pthread_cond_broadcast(&workers->wake);
+  pthread_mutex_unlock(&workers->lock);
+
+  Workers_work(workers, 0);
+
+  pthread_mutex_lock(&workers->lock);
+
+  while (workers->busy > 0) {
+    pthread_cond_wait(&workers->done, &workers->lock);
+  }
+
+  pthread_mutex_unlock(&workers->lock);
+}
+
+WorkerStats Workers_stats(const Workers *workers, size_t worker) { return workers->workers[worker].stats; }
+
+// The time worker spent running chunks since the last reset.
+double Workers_busyNanoseconds(const Workers *workers, size_t worker) {
+  return Timer_stampNanoseconds(workers->workers[worker].stats.busy);
+}
+
+void Workers_resetStats(Workers *workers) {
+  for (size_t w = 0; w < workers->count; w++) {
+    workers->workers[w].stats = (WorkerStats){0};
+  }
+}
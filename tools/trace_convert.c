@@ -0,0 +1,128 @@
+// Convert a binary trace recorded with --trace into the JSON data file layout, or into CSV for spreadsheets.
+// Build it with `make trace-convert`.
+// Usage: trace_convert [--csv] TRACE [OUTPUT]
+// OUTPUT defaults to TRACE with its extension replaced by .json or .csv, an OUTPUT ending in .csv implies --csv.
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <trace.h>
+#include <utils.h>
+
+// One row per tick, with the same fields and units as the JSON data file.
+static bool writeCSV(FILE *trace, const TraceHeader *header, const char *path, size_t *points) {
+  FILE *file = fopen(path, "w");
+
+  if (!file) {
+    return false;
+  }
+
+  fputs("time,fps,tick,allocations", file);
+
+  for (size_t p = 0; header->phaseTiming && p < PHASE_COUNT; p++) {
+    fprintf(file, ",%s", PHASE_NAMES[p]);
+  }
+
+  for (size_t c = 0; c < COUNTER_COUNT; c++) {
+    if (header->counters & (1u << c)) {
+      fprintf(file, ",%s", COUNTER_NAMES[c]);
+    }
+  }
+
+  fputc('\n', file);
+
+  JSONDataPoint point;
+
+  while (Trace_readPoint(trace, &point)) {
+    fprintf(file, "%.9f,%.9g,%.9f,%zu", point.time / 1e9, point.fps, point.tick / 1e9, point.allocations);
+
+    for (size_t p = 0; header->phaseTiming && p < PHASE_COUNT; p++) {
+      fprintf(file, ",%.9f", point.phases[p] / 1e9);
+    }
+
+    for (size_t c = 0; c < COUNTER_COUNT; c++) {
+      if (header->counters & (1u << c)) {
+        fprintf(file, ",%" PRIu64, point.counters[c]);
+      }
+    }
+
+    fputc('\n', file);
+    (*points)++;
+  }
+
+  bool written = !ferror(file);
+  return fclose(file) == 0 && written;
+}
+
+static bool writeJSON(FILE *trace, const TraceHeader *header, const char *path, size_t *points) {
+  DataStream stream;
+
+  if (!DataStream_open(&stream, path, header->objectCount, header->phaseTiming, header->counters)) {
+    return false;
+  }
+
+  JSONDataPoint point;
+
+  while (Trace_readPoint(trace, &point)) {
+    DataStream_write(&stream, &point);
+  }
+
+  *points = stream.points;
+  return DataStream_close(&stream);
+}
+
+int main(int argc, char **argv) {
+  bool csv = argc > 1 && strcmp(argv[1], "--csv") == 0;
+  int first = csv ? 2 : 1;
+
+  if (argc - first < 1 || argc - first > 2) {
+    fprintf(stderr, "Usage: %s [--csv] TRACE [OUTPUT]\n", argv[0]);
+    return 1;
+  }
+
+  const char *input = argv[first];
+  FILE *trace = fopen(input, "rb");
+  TraceHeader header;
+
+  if (!trace) {
+    fprintf(stderr, "Failed to open %s.\n", input);
+    return 1;
+  }
+
+  if (!Trace_readHeader(trace, &header)) {
+    fprintf(stderr, "%s is not a version %d trace with %d phases and %d counters.\n", input, TRACE_VERSION,
+            PHASE_COUNT, COUNTER_COUNT);
+    fclose(trace);
+    return 1;
+  }
+
+  char output[1024];
+
+  if (argc - first == 2) {
+    const char *dot = strrchr(argv[first + 1], '.');
+    snprintf(output, sizeof(output), "%s", argv[first + 1]);
+    csv = csv || (dot && strcmp(dot, ".csv") == 0);
+  } else {
+    // Replace the extension of the trace, or append one if it has none.
+    const char *dot = strrchr(input, '.');
+    const char *slash = strrchr(input, '/');
+    int stem = dot && (!slash || dot > slash) ? (int)(dot - input) : (int)strlen(input);
+    snprintf(output, sizeof(output), "%.*s.%s", stem, input, csv ? "csv" : "json");
+  }
+
+  size_t points = 0;
+  bool written = csv ? writeCSV(trace, &header, output, &points) : writeJSON(trace, &header, output, &points);
+  fclose(trace);
+
+  if (!written) {
+    fprintf(stderr, "Failed to write %s.\n", output);
+    return 1;
+  }
+
+  header.engine[sizeof(header.engine) - 1] = '\0';
+  header.broadphase[sizeof(header.broadphase) - 1] = '\0';
+  printf("%s %s run %" PRId32 " (seed %" PRIu64 "): %" PRIu64 " objects, %zu ticks -> %s\n", header.engine,
+         header.broadphase, header.run, header.seed, header.objectCount, points, output);
+  return 0;
+}